@@ -18,7 +18,7 @@
 #define SA1LVL_SURFFLAG_VISIBLE                0x80000000
 
 // SA1LVL basic loader
-void SA1LVL_IndexVertexBasic(SALVL_MeshPart &meshpart, NJS_MODEL_SADX *model, NJS_MESHSET_SADX *meshset, SALVL_MeshFace i, SALVL_MeshFace j)
+void SA1LVL_IndexVertexBasic(SALVL_MeshPart &meshpart, NJS_MODEL_SADX *model, NJS_MESHSET_SADX *meshset, const Sint16 (&i)[3], const Sint16 (&j)[3])
 {
 	SALVL_Vertex vertex[3];
 	SALVL_MeshFace pi;
@@ -26,16 +26,16 @@ void SA1LVL_IndexVertexBasic(SALVL_MeshPart &meshpart, NJS_MODEL_SADX *model, NJ
 	for (int k = 0; k < 3; k++)
 	{
 		// Construct vertex
-		vertex[k].pos.x = model->points[i.i[k]].x;
-		vertex[k].pos.y = model->points[i.i[k]].y;
-		vertex[k].pos.z = model->points[i.i[k]].z;
-		vertex[k].nor.x = model->normals[i.i[k]].x;
-		vertex[k].nor.y = model->normals[i.i[k]].y;
-		vertex[k].nor.z = model->normals[i.i[k]].z;
+		vertex[k].pos.x = model->points[i[k]].x;
+		vertex[k].pos.y = model->points[i[k]].y;
+		vertex[k].pos.z = model->points[i[k]].z;
+		vertex[k].nor.x = model->normals[i[k]].x;
+		vertex[k].nor.y = model->normals[i[k]].y;
+		vertex[k].nor.z = model->normals[i[k]].z;
 		if (meshset->vertuv != nullptr)
 		{
-			vertex[k].tex.x = meshset->vertuv[j.i[k]].u / 256.0f;
-			vertex[k].tex.y = meshset->vertuv[j.i[k]].v / 256.0f;
+			vertex[k].tex.x = meshset->vertuv[j[k]].u / 256.0f;
+			vertex[k].tex.y = meshset->vertuv[j[k]].v / 256.0f;
 			if (meshpart.matflags & NJD_FLAG_FLIP_U)
 				vertex[k].tex.x *= 0.5f;
 			if (meshpart.matflags & NJD_FLAG_FLIP_V)
@@ -121,7 +121,7 @@ void SA1LVL_LoadBasic(SALVL &lvl, COL *colp, NJS_MODEL_SADX *model)
 	}
 
 	// Push mesh to map
-	lvl.meshes[model] = mesh;
+	lvl.meshes[model] = std::move(mesh);
 }
 
 // SA1LVL loader
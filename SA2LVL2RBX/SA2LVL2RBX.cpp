@@ -217,7 +217,7 @@ void SA2LVL_LoadChunk(SALVL &lvl, COL *colp, NJS_CNK_MODEL *model)
 				for (Sint16 j = 0; j < strip_count; j++)
 				{
 					// Read index data
-					std::vector<Sint16> rawindices;
+					std::vector<SALVL_Index> rawindices;
 					Uint16 indices = ((pchunkp[0] < 0) ? -pchunkp[0] : pchunkp[0]);
 					Uint16 reversed = pchunkp[0] & 0x8000;
 					pchunkp++;
@@ -265,7 +265,7 @@ void SA2LVL_LoadChunk(SALVL &lvl, COL *colp, NJS_CNK_MODEL *model)
 				for (Sint16 j = 0; j < strip_count; j++)
 				{
 					// Read index data
-					std::vector<Sint16> rawindices;
+					std::vector<SALVL_Index> rawindices;
 					Uint16 indices = ((pchunkp[0] < 0) ? -pchunkp[0] : pchunkp[0]);
 					Uint16 reversed = pchunkp[0] & 0x8000;
 					pchunkp++;
@@ -314,11 +314,11 @@ void SA2LVL_LoadChunk(SALVL &lvl, COL *colp, NJS_CNK_MODEL *model)
 	}
 
 	// Push mesh to map
-	lvl.meshes[model] = chunk_model.mesh;
+	lvl.meshes[model] = std::move(chunk_model.mesh);
 }
 
 // SA2LVL basic loader
-void SA2LVL_IndexVertexBasic(SALVL_MeshPart &meshpart, NJS_MODEL *model, NJS_MESHSET *meshset, SALVL_MeshFace i, SALVL_MeshFace j)
+void SA2LVL_IndexVertexBasic(SALVL_MeshPart &meshpart, NJS_MODEL *model, NJS_MESHSET *meshset, const Sint16 (&i)[3], const Sint16 (&j)[3])
 {
 	SALVL_Vertex vertex[3];
 	SALVL_MeshFace pi;
@@ -326,16 +326,16 @@ void SA2LVL_IndexVertexBasic(SALVL_MeshPart &meshpart, NJS_MODEL *model, NJS_MES
 	for (int k = 0; k < 3; k++)
 	{
 		// Construct vertex
-		vertex[k].pos.x = model->points[i.i[k]].x;
-		vertex[k].pos.y = model->points[i.i[k]].y;
-		vertex[k].pos.z = model->points[i.i[k]].z;
-		vertex[k].nor.x = model->normals[i.i[k]].x;
-		vertex[k].nor.y = model->normals[i.i[k]].y;
-		vertex[k].nor.z = model->normals[i.i[k]].z;
+		vertex[k].pos.x = model->points[i[k]].x;
+		vertex[k].pos.y = model->points[i[k]].y;
+		vertex[k].pos.z = model->points[i[k]].z;
+		vertex[k].nor.x = model->normals[i[k]].x;
+		vertex[k].nor.y = model->normals[i[k]].y;
+		vertex[k].nor.z = model->normals[i[k]].z;
 		if (meshset->vertuv != nullptr)
 		{
-			vertex[k].tex.x = meshset->vertuv[j.i[k]].u / 256.0f;
-			vertex[k].tex.y = meshset->vertuv[j.i[k]].v / 256.0f;
+			vertex[k].tex.x = meshset->vertuv[j[k]].u / 256.0f;
+			vertex[k].tex.y = meshset->vertuv[j[k]].v / 256.0f;
 			if (meshpart.matflags & NJD_FLAG_FLIP_U)
 				vertex[k].tex.x *= 0.5f;
 			if (meshpart.matflags & NJD_FLAG_FLIP_V)
@@ -421,7 +421,7 @@ void SA2LVL_LoadBasic(SALVL &lvl, COL *colp, NJS_MODEL *model)
 	}
 
 	// Push mesh to map
-	lvl.meshes[model] = mesh;
+	lvl.meshes[model] = std::move(mesh);
 }
 
 struct SA2BVertex
@@ -704,7 +704,7 @@ static void SA2LVL_LoadSA2BGeom(SALVL &lvl, SALVL_Mesh &mesh, SA2B_GeometryData
 	for (auto &prim : prims)
 	{
 		// Creating the polygons
-		std::vector<unsigned short> indices;
+		std::vector<SALVL_Index> indices;
 
 		if (prim.head->primitive_type == GCPrimitiveType::Triangles)
 		{
@@ -827,7 +827,7 @@ static void SA2LVL_LoadSA2BModel(SALVL &lvl, COL *colp, SA2B_Model *model)
 	}
 
 	// Push mesh to map
-	lvl.meshes[model] = mesh;
+	lvl.meshes[model] = std::move(mesh);
 }
 
 // SA2LVL loader
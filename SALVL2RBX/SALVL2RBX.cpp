@@ -7,9 +7,19 @@
 #include <cmath>
 #include <limits>
 #include <set>
+#include <map>
+#include <tuple>
 #include <algorithm>
 #include <regex>
 #include <iomanip>
+#include <charconv>
+#include <string_view>
+#include <thread>
+#include <array>
+#include <mutex>
+#include <new>
+#include <atomic>
+#include <exception>
 
 #include <Winsock2.h>
 #include <wininet.h>
@@ -17,228 +27,3478 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+static bool DoesThisFileExist(const std::string &name)
+{
+	std::ifstream f(name.c_str());
+	return f.good();
+}
+
+struct SALVL_MappedFile
+{
+	// Read only view of a whole file
+	HANDLE file = INVALID_HANDLE_VALUE, mapping = NULL;
+	const char *data = nullptr;
+	size_t size = 0;
+
+	bool Open(const std::string &path)
+	{
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return true;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size))
+			return true;
+		size = (size_t)file_size.QuadPart;
+		if (size == 0)
+			return false; // Empty files can't be mapped
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return true;
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		return data == nullptr;
+	}
+
+	~SALVL_MappedFile()
+	{
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+	}
+};
+
+// Roblox enums
+constexpr SALVL_Material rbxenum_material[] = {
+	{ "Plastic", 256, "256" },
+	{ "SmoothPlastic", 272, "272" },
+	{ "Neon", 288, "288" },
+	{ "Wood", 512, "512" },
+	{ "WoodPlanks", 528, "528" },
+	{ "Marble", 784, "784" },
+	{ "Basalt", 788, "788" },
+	{ "Slate", 800, "800" },
+	{ "CrackedLava", 804, "804" },
+	{ "Concrete", 816, "816" },
+	{ "Limestone", 820, "820" },
+	{ "Granite", 832, "832" },
+	{ "Pavement", 836, "836" },
+	{ "Brick", 848, "848" },
+	{ "Pebble", 864, "864" },
+	{ "Cobblestone", 880, "880" },
+	{ "Rock", 896, "896" },
+	{ "Sandstone", 912, "912" },
+	{ "CorrodedMetal", 1040, "1040" },
+	{ "DiamondPlate", 1056, "1056" },
+	{ "Foil", 1072, "1072" },
+	{ "Metal", 1088, "1088" },
+	{ "Grass", 1280, "1280" },
+	{ "LeafyGrass", 1284, "1284" },
+	{ "Sand", 1296, "1296" },
+	{ "Fabric", 1312, "1312" },
+	{ "Snow", 1328, "1328" },
+	{ "Mud", 1344, "1344" },
+	{ "Ground", 1360, "1360" },
+	{ "Asphalt", 1376, "1376" },
+	{ "Salt", 1392, "1392" },
+	{ "Ice", 1536, "1536" },
+	{ "Glacier", 1552, "1552" },
+	{ "Glass", 1568, "1568" },
+	{ "ForceField", 1584, "1584" },
+	{ "Air", 1792, "1792" },
+	{ "Water", 2048, "2048" },
+	{ "Cardboard", 2304, "2304" },
+	{ "Carpet", 2305, "2305" },
+	{ "CeramicTiles", 2306, "2306" },
+	{ "ClayRoofTiles", 2307, "2307" },
+	{ "RoofShingles", 2308, "2308" },
+	{ "Leather", 2309, "2309" },
+	{ "Plaster", 2310, "2310" },
+	{ "Rubber", 2311, "2311" },
+};
+static constexpr size_t rbxenum_material_count = sizeof(rbxenum_material) / sizeof(rbxenum_material[0]);
+
+static constexpr Uint32 Material_Hash(std::string_view name)
+{
+	// FNV-1a
+	Uint32 h = 0x811C9DC5U;
+	for (char c : name)
+		h = (h ^ (Uint8)c) * 0x01000193U;
+	return h;
+}
+
+static constexpr Uint32 Material_Slot(Uint32 hash, Uint32 seed)
+{
+	// Seeded multiplicative mix down to 9 bits
+	return ((hash ^ seed) * 0x9E3779B1U) >> 23;
+}
+
+struct SALVL_MaterialHash
+{
+	Uint32 seed = 0;
+	Sint8 slot[512] = {};
+};
+
+static constexpr SALVL_MaterialHash Material_BuildHash()
+{
+	// Find a seed that gives every material its own slot, tracking used slots in a bitmask
+	Uint32 hashes[rbxenum_material_count] = {};
+	for (size_t i = 0; i < rbxenum_material_count; i++)
+		hashes[i] = Material_Hash(rbxenum_material[i].name);
+
+	SALVL_MaterialHash hash;
+	for (hash.seed = 0; hash.seed < 0x1000; hash.seed++)
+	{
+		std::uint64_t used[8] = {};
+		size_t i = 0;
+		for (; i < rbxenum_material_count; i++)
+		{
+			Uint32 slot = Material_Slot(hashes[i], hash.seed);
+			if (used[slot >> 6] & (1ULL << (slot & 63)))
+				break;
+			used[slot >> 6] |= 1ULL << (slot & 63);
+		}
+		if (i != rbxenum_material_count)
+			continue;
+
+		for (auto &j : hash.slot)
+			j = -1;
+		for (i = 0; i < rbxenum_material_count; i++)
+			hash.slot[Material_Slot(hashes[i], hash.seed)] = (Sint8)i;
+		break;
+	}
+	return hash;
+}
+
+static constexpr bool Material_TokensMatch()
+{
+	// Tokens are the enum value in decimal
+	for (auto &i : rbxenum_material)
+	{
+		Uint32 value = 0;
+		for (char c : i.token)
+			value = value * 10 + (c - '0');
+		if (i.token.empty() || value != i.value)
+			return false;
+	}
+	return true;
+}
+
+static constexpr SALVL_MaterialHash rbxenum_material_hash = Material_BuildHash();
+static_assert(rbxenum_material_count < 128 && rbxenum_material_hash.seed < 0x1000, "No perfect hash seed for the material table");
+static_assert(Material_TokensMatch(), "Material token doesn't match its value");
+
+static const SALVL_Material *Material_Find(std::string_view name)
+{
+	// Perfect hash lookup, one probe and one compare
+	Sint8 slot = rbxenum_material_hash.slot[Material_Slot(Material_Hash(name), rbxenum_material_hash.seed)];
+	if (slot >= 0 && rbxenum_material[slot].name == name)
+		return &rbxenum_material[slot];
+	return nullptr;
+}
+
+// Buffer writes
+template<typename T> void Push16(std::vector<T> &stream, Uint16 x)
+{
+	stream.push_back((T)x);
+	stream.push_back((T)(x >> 8));
+}
+template<typename T> void Push32(std::vector<T> &stream, Uint32 x)
+{
+	stream.push_back((T)x);
+	stream.push_back((T)(x >> 8));
+	stream.push_back((T)(x >> 16));
+	stream.push_back((T)(x >> 24));
+}
+template<typename T> void PushFloat(std::vector<T> &stream, float x)
+{
+	Push32<T>(stream, *(Uint32*)&x);
+}
+template<typename T> void Push32BE(std::vector<T> &stream, Uint32 x)
+{
+	stream.push_back((T)(x >> 24));
+	stream.push_back((T)(x >> 16));
+	stream.push_back((T)(x >> 8));
+	stream.push_back((T)x);
+}
+
+// CSG mesh
+#include "md5.h"
+
+static size_t Base64Size(size_t size, size_t line)
+{
+	// Encoded characters plus a line break between full lines
+	size_t chars = (size + 2) / 3 * 4;
+	if (line != 0 && chars != 0)
+		chars += (chars - 1) / line;
+	return chars;
+}
+
+static void Base64(const Uint8 *data, size_t size, char *out, size_t line = 0, MD5 *md5 = nullptr)
+{
+	// Encode with line breaks every line characters (a multiple of 4), feeding output to MD5 as we go
+	static const char *lookup = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	static const size_t md5_block = 0x1000;
+
+	size_t line_bytes = (line != 0) ? (line / 4 * 3) : size;
+	char *md5_p = out;
+
+	for (size_t pos = 0; pos < size; pos += line_bytes)
+	{
+		if (pos != 0)
+			*out++ = '\n';
+
+		const Uint8 *p = data + pos;
+		size_t left = std::min(line_bytes, size - pos);
+
+	#ifdef SALVL_SSE2
+		// Split 12 bytes into 16 sextets, then translate them to ASCII with SSE2
+		for (; left >= 12; left -= 12, p += 12, out += 16)
+		{
+			alignas(16) Uint8 sextets[16];
+			for (int k = 0; k < 4; k++)
+			{
+				Uint32 v = ((Uint32)p[k * 3] << 16) | ((Uint32)p[k * 3 + 1] << 8) | p[k * 3 + 2];
+				sextets[k * 4 + 0] = (Uint8)(v >> 18);
+				sextets[k * 4 + 1] = (Uint8)((v >> 12) & 0x3F);
+				sextets[k * 4 + 2] = (Uint8)((v >> 6) & 0x3F);
+				sextets[k * 4 + 3] = (Uint8)(v & 0x3F);
+			}
+
+			__m128i idx = _mm_load_si128((const __m128i*)sextets);
+			__m128i offset = _mm_set1_epi8(65);
+			offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(25)), _mm_set1_epi8(6)));
+			offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(51)), _mm_set1_epi8(-75)));
+			offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(61)), _mm_set1_epi8(-15)));
+			offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(62)), _mm_set1_epi8(3)));
+			_mm_storeu_si128((__m128i*)out, _mm_add_epi8(idx, offset));
+		}
+	#endif
+
+		for (; left >= 3; left -= 3, p += 3, out += 4)
+		{
+			Uint32 v = ((Uint32)p[0] << 16) | ((Uint32)p[1] << 8) | p[2];
+			out[0] = lookup[v >> 18];
+			out[1] = lookup[(v >> 12) & 0x3F];
+			out[2] = lookup[(v >> 6) & 0x3F];
+			out[3] = lookup[v & 0x3F];
+		}
+
+		if (left != 0)
+		{
+			// Padded tail
+			Uint32 v = ((Uint32)p[0] << 16) | ((left > 1) ? ((Uint32)p[1] << 8) : 0);
+			out[0] = lookup[v >> 18];
+			out[1] = lookup[(v >> 12) & 0x3F];
+			out[2] = (left > 1) ? lookup[(v >> 6) & 0x3F] : '=';
+			out[3] = '=';
+			out += 4;
+		}
+
+		if (md5 != nullptr && (size_t)(out - md5_p) >= md5_block)
+		{
+			md5->Update((unsigned char*)md5_p, (unsigned int)(out - md5_p));
+			md5_p = out;
+		}
+	}
+
+	if (md5 != nullptr && out != md5_p)
+		md5->Update((unsigned char*)md5_p, (unsigned int)(out - md5_p));
+}
+
+static inline void Put32(Uint8 *&p, Uint32 x)
+{
+	p[0] = (Uint8)x;
+	p[1] = (Uint8)(x >> 8);
+	p[2] = (Uint8)(x >> 16);
+	p[3] = (Uint8)(x >> 24);
+	p += 4;
+}
+static inline void PutFloat(Uint8 *&p, float x)
+{
+	Uint32 bits;
+	memcpy(&bits, &x, 4);
+	Put32(p, bits);
+}
+
+struct SALVL_CSGMesh
+{
+	// Encoded data
+	std::vector<Uint8> data; // Raw data
+	Uint8 hash[16] = {}; // Raw MD5 hash
+	std::string enc_base64; // Base64 encoded
+	std::string enc_hash; // MD5 hash
+
+	void Build(const SALVL_MeshPart &meshpart)
+	{
+		// Group faces into convex regions, each becoming one hull
+		static const size_t max_faces = 32, max_vertices = 64;
+		static const float epsilon = 0.01f;
+
+		std::vector<SALVL_Index> edge_start;
+		std::vector<SALVL_EdgeRef> edges;
+		meshpart.BuildEdges(edge_start, edges);
+
+		// Get face planes
+		struct Plane
+		{
+			NJS_VECTOR n;
+			float d;
+			bool valid;
+		};
+		std::vector<Plane> planes(meshpart.indices.size());
+		for (size_t f = 0; f < meshpart.indices.size(); f++)
+		{
+			const auto &va = meshpart.vertex[meshpart.indices[f].i[0]].pos;
+			const auto &vb = meshpart.vertex[meshpart.indices[f].i[1]].pos;
+			const auto &vc = meshpart.vertex[meshpart.indices[f].i[2]].pos;
+
+			NJS_VECTOR ab = {vb.x - va.x, vb.y - va.y, vb.z - va.z};
+			NJS_VECTOR ac = {vc.x - va.x, vc.y - va.y, vc.z - va.z};
+			NJS_VECTOR n = {ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x};
+			float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+			Plane &plane = planes[f];
+			plane.valid = length > 0.0f;
+			if (plane.valid)
+			{
+				plane.n = {n.x / length, n.y / length, n.z / length};
+				plane.d = plane.n.x * va.x + plane.n.y * va.y + plane.n.z * va.z;
+			}
+		}
+		auto behind = [&](const Plane &plane, const NJS_VECTOR &v)
+		{
+			return (plane.n.x * v.x + plane.n.y * v.y + plane.n.z * v.z - plane.d) <= epsilon;
+		};
+
+		// Regions are stored flat, as faces and unique vertices with start offsets
+		std::vector<SALVL_Index> region_face, region_vertex;
+		std::vector<size_t> region_face_start = {0}, region_vertex_start = {0};
+		std::vector<bool> assigned(meshpart.indices.size(), false);
+
+		for (size_t seed = 0; seed < meshpart.indices.size(); seed++)
+		{
+			if (assigned[seed])
+				continue;
+			assigned[seed] = true;
+
+			// Grow region breadth first through shared edges while it stays convex
+			size_t face_base = region_face.size(), vertex_base = region_vertex.size();
+			region_face.push_back((SALVL_Index)seed);
+			region_vertex.insert(region_vertex.end(), meshpart.indices[seed].i, meshpart.indices[seed].i + 3);
+
+			auto find_vertex = [&](SALVL_Index i)
+			{
+				return std::find(region_vertex.begin() + vertex_base, region_vertex.end(), i) != region_vertex.end();
+			};
+
+			for (size_t head = face_base; head < region_face.size() && planes[seed].valid; head++)
+			{
+				const SALVL_MeshFace &face = meshpart.indices[region_face[head]];
+				for (int k = 0; k < 3; k++)
+				{
+					SALVL_Index lo = std::min(face.i[k], face.i[(k + 1) % 3]);
+					SALVL_Index hi = std::max(face.i[k], face.i[(k + 1) % 3]);
+					auto range = SALVL_MeshPart::FindEdge(edge_start, edges, lo, hi);
+					for (const SALVL_EdgeRef *e = range.first; e != range.second; e++)
+					{
+						SALVL_Index f = e->face;
+						if (assigned[f] || (region_face.size() - face_base) >= max_faces)
+							continue;
+
+						// Candidate must face the same way and keep the region convex
+						const Plane &plane = planes[f];
+						const SALVL_MeshFace &cand = meshpart.indices[f];
+						if (!plane.valid || (plane.n.x * planes[seed].n.x + plane.n.y * planes[seed].n.y + plane.n.z * planes[seed].n.z) <= 0.0f)
+							continue;
+
+						size_t new_vertices = 0;
+						for (auto &i : cand.i)
+							if (!find_vertex(i))
+								new_vertices++;
+						if ((region_vertex.size() - vertex_base) + new_vertices > max_vertices)
+							continue;
+
+						bool convex = true;
+						for (size_t r = vertex_base; r < region_vertex.size() && convex; r++)
+							convex = behind(plane, meshpart.vertex[region_vertex[r]].pos);
+						for (size_t r = face_base; r < region_face.size() && convex; r++)
+							for (auto &i : cand.i)
+								convex = convex && behind(planes[region_face[r]], meshpart.vertex[i].pos);
+						if (!convex)
+							continue;
+
+						// Add face to region
+						assigned[f] = true;
+						region_face.push_back(f);
+						for (auto &i : cand.i)
+							if (!find_vertex(i))
+								region_vertex.push_back(i);
+					}
+				}
+			}
+
+			region_face_start.push_back(region_face.size());
+			region_vertex_start.push_back(region_vertex.size());
+		}
+
+		// Size buffer exactly
+		size_t regions = region_face_start.size() - 1;
+		static const size_t sizeof_header = 4 + 16 + 4 + 16 + 4 + 4; // TriIndices, TransformOffsets, numCoords, sizeof_float
+		std::vector<Uint8> csgmesh_data(6 + 4 + regions * (sizeof_header + 4) + region_vertex.size() * 6 * 4 + region_face.size() * 6 * 4);
+		Uint8 *p = csgmesh_data.data();
+
+		memcpy(p, "CSGPHS", 6);
+		p += 6;
+		Put32(p, 3);
+
+		static const Uint8 transform_offsets[16] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x3F };
+
+		for (size_t r = 0; r < regions; r++)
+		{
+			const SALVL_Index *rv = region_vertex.data() + region_vertex_start[r];
+			size_t nv = region_vertex_start[r + 1] - region_vertex_start[r];
+
+			// Write dummied out header
+			Put32(p, 16); // sizeof_TriIndices
+			memset(p, 0, 16); // TriIndices[16]
+			p += 16;
+			Put32(p, 16); // sizeof_TransformOffsets
+			memcpy(p, transform_offsets, 16); // TransformOffsets[16]
+			p += 16;
+
+			// Write vertices, then the same vertices extruded back along their normals
+			Put32(p, (Uint32)(nv * 6)); // numCoords
+			Put32(p, 4); // sizeof_float
+
+			for (size_t i = 0; i < nv; i++)
+			{
+				const SALVL_Vertex &v = meshpart.vertex[rv[i]];
+				PutFloat(p, v.pos.x); PutFloat(p, v.pos.y); PutFloat(p, v.pos.z);
+			}
+			for (size_t i = 0; i < nv; i++)
+			{
+				const SALVL_Vertex &v = meshpart.vertex[rv[i]];
+				PutFloat(p, v.pos.x - v.nor.x * 0.125f); PutFloat(p, v.pos.y - v.nor.y * 0.125f); PutFloat(p, v.pos.z - v.nor.z * 0.125f);
+			}
+
+			// Write indices, front faces then reversed back faces
+			Put32(p, (Uint32)((region_face_start[r + 1] - region_face_start[r]) * 6)); // numIndices
+			for (size_t f = region_face_start[r]; f < region_face_start[r + 1]; f++)
+			{
+				Uint32 l[3];
+				for (int k = 0; k < 3; k++)
+					l[k] = (Uint32)(std::find(rv, rv + nv, meshpart.indices[region_face[f]].i[k]) - rv);
+				Put32(p, l[0]); Put32(p, l[1]); Put32(p, l[2]); // Front
+				Put32(p, (Uint32)nv + l[2]); Put32(p, (Uint32)nv + l[1]); Put32(p, (Uint32)nv + l[0]); // Back
+			}
+		}
+
+		Encode(csgmesh_data);
+	}
+
+	void Encode(std::vector<Uint8> &data)
+	{
+		// Encode to Base64 with line breaks (UGH), hashing the text with MD5 as it's produced
+		MD5 md5;
+		md5.Init();
+
+		enc_base64.resize(Base64Size(data.size(), 72));
+		Base64(data.data(), data.size(), &enc_base64[0], 72, &md5);
+		md5.Final();
+
+		// Encode MD5 to Base64
+		enc_hash.resize(Base64Size(16, 0));
+		Base64(md5.digestRaw, 16, &enc_hash[0]);
+		memcpy(hash, md5.digestRaw, 16);
+
+		// Keep raw data for binary output
+		this->data = std::move(data);
+	}
+};
+
+// RBXMX writer
+class SALVL_XMLWriter
+{
+	private:
+		// Output state
+		std::ofstream stream;
+		std::string buffer;
+		size_t buffer_limit = 0;
+
+	public:
+		bool Open(const std::string &path, size_t limit = 1 << 22)
+		{
+			// Open stream and reserve buffer
+			stream.open(path, std::ios::binary);
+			buffer_limit = limit;
+			buffer.clear();
+			buffer.reserve(limit + 0x1000);
+			return stream.is_open();
+		}
+
+		void Flush()
+		{
+			stream.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+
+		bool Close()
+		{
+			Flush();
+			stream.close();
+			return !stream.fail();
+		}
+
+		SALVL_XMLWriter &operator<<(std::string_view x)
+		{
+			buffer.append(x.data(), x.size());
+			if (buffer.size() >= buffer_limit)
+				Flush();
+			return *this;
+		}
+
+		SALVL_XMLWriter &operator<<(float x)
+		{
+			// Shortest round-trip representation
+			char out[32];
+			auto result = std::to_chars(out, out + sizeof(out), x);
+			return *this << std::string_view(out, result.ptr - out);
+		}
+
+		SALVL_XMLWriter &operator<<(Uint32 x)
+		{
+			char out[16];
+			auto result = std::to_chars(out, out + sizeof(out), x);
+			return *this << std::string_view(out, result.ptr - out);
+		}
+};
+
+struct SALVL_RBXMXPart
+{
+	// Part being written
+	const SALVL_MeshPartInstance *instance = nullptr;
+	const SALVL_CSGMesh *csgmesh = nullptr; // Collision parts only
+	float scale = 1.0f;
+	bool collision = false;
+};
+
+#define SALVL_RBXMX_COLLISION (1 << 0)
+#define SALVL_RBXMX_VISUAL    (1 << 1)
+
+#define SALVL_PROP_BOOL         0
+#define SALVL_PROP_FLOAT        1
+#define SALVL_PROP_STRING       2
+#define SALVL_PROP_CONTENT      3 // Left out of RBXMX when empty
+#define SALVL_PROP_TOKEN        4
+#define SALVL_PROP_SHAREDSTRING 5 // Referenced by MD5 hash
+#define SALVL_PROP_VECTOR3      6
+#define SALVL_PROP_CFRAME       7
+#define SALVL_PROP_COLOR3UINT8  8
+
+struct SALVL_PropertyValue
+{
+	Uint32 u = 0; // Bool, token value, 0xRRGGBB colour
+	float f[12] = {}; // Float, Vector3, CFrame position then rotation
+	std::string_view s; // String, content url, shared string hash, token text
+};
+
+struct SALVL_RBXProperty
+{
+	// MeshPart property shared by the RBXMX and RBXM writers
+	const char *name;
+	Uint8 type;
+	Uint8 folders; // Parts in other folders are left at the default value
+	void (*get)(const SALVL_RBXMXPart &part, SALVL_PropertyValue &value);
+};
+
+static bool RBXMX_HasTexture(const SALVL_MeshPart *meshpart)
+{
+	return (meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr;
+}
+
+static constexpr SALVL_RBXProperty rbx_meshpart_properties[] = {
+	{ "Name", SALVL_PROP_STRING, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		const SALVL_MeshPart *meshpart = part.instance->meshpart;
+		value.s = RBXMX_HasTexture(meshpart) ? meshpart->name_texture : std::string_view("Collision");
+	} },
+	{ "Anchored", SALVL_PROP_BOOL, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.u = 1;
+	} },
+	{ "CanCollide", SALVL_PROP_BOOL, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.u = part.collision ? 1 : 0;
+	} },
+	{ "CanTouch", SALVL_PROP_BOOL, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.u = 0;
+	} },
+#ifdef SALVL_DOUBLESIDED
+	{ "DoubleSided", SALVL_PROP_BOOL, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.u = 1;
+	} },
+#endif
+	{ "CFrame", SALVL_PROP_CFRAME, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		const SALVL_MeshPartInstance &i = *part.instance;
+		float cframe[12] = {
+			i.pos.x * part.scale, i.pos.y * part.scale, i.pos.z * part.scale,
+			i.matrix[M00], i.matrix[M01], i.matrix[M02],
+			i.matrix[M10], i.matrix[M11], i.matrix[M12],
+			i.matrix[M20], i.matrix[M21], i.matrix[M22],
+		};
+		memcpy(value.f, cframe, sizeof(cframe));
+	} },
+	{ "size", SALVL_PROP_VECTOR3, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		const SALVL_MeshPart *meshpart = part.instance->meshpart;
+		value.f[0] = meshpart->size.x * part.scale;
+		value.f[1] = meshpart->size.y * part.scale;
+		value.f[2] = meshpart->size.z * part.scale;
+	} },
+	{ "InitialSize", SALVL_PROP_VECTOR3, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		const SALVL_MeshPart *meshpart = part.instance->meshpart;
+		value.f[0] = meshpart->size.x;
+		value.f[1] = meshpart->size.y;
+		value.f[2] = meshpart->size.z;
+	} },
+	{ "MeshID", SALVL_PROP_CONTENT, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.s = part.instance->meshpart->url;
+	} },
+	{ "TextureID", SALVL_PROP_CONTENT, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		const SALVL_MeshPart *meshpart = part.instance->meshpart;
+		if (RBXMX_HasTexture(meshpart))
+			value.s = meshpart->url_texture;
+	} },
+	{ "Material", SALVL_PROP_TOKEN, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		const SALVL_MeshPart *meshpart = part.instance->meshpart;
+		const SALVL_Material *material = RBXMX_HasTexture(meshpart) ? meshpart->texture->material : &rbxenum_material[0];
+		value.u = material->value;
+		value.s = material->token;
+	} },
+	{ "PhysicalConfigData", SALVL_PROP_SHAREDSTRING, SALVL_RBXMX_COLLISION, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.s = part.csgmesh->enc_hash;
+	} },
+	{ "Transparency", SALVL_PROP_FLOAT, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.f[0] = (part.instance->surf_flag & SALVL_SURFFLAG_VISIBLE) ? 0.0f : 1.0f;
+	} },
+	{ "Color3uint8", SALVL_PROP_COLOR3UINT8, SALVL_RBXMX_COLLISION | SALVL_RBXMX_VISUAL, [](const SALVL_RBXMXPart &part, SALVL_PropertyValue &value)
+	{
+		value.u = part.instance->meshpart->diffuse;
+	} },
+};
+
+static void RBXMX_WriteProperty(SALVL_XMLWriter &xml, const SALVL_RBXProperty &prop, const SALVL_PropertyValue &value)
+{
+	switch (prop.type)
+	{
+		case SALVL_PROP_BOOL:
+			xml << "<bool name=\"" << prop.name << "\">" << (value.u ? "true" : "false") << "</bool>\n";
+			break;
+		case SALVL_PROP_FLOAT:
+			xml << "<float name=\"" << prop.name << "\">" << value.f[0] << "</float>\n";
+			break;
+		case SALVL_PROP_STRING:
+			xml << "<string name=\"" << prop.name << "\">" << value.s << "</string>\n";
+			break;
+		case SALVL_PROP_CONTENT:
+			if (!value.s.empty())
+				xml << "<Content name=\"" << prop.name << "\"><url>" << value.s << "</url></Content>\n";
+			break;
+		case SALVL_PROP_TOKEN:
+			xml << "<token name=\"" << prop.name << "\">" << value.s << "</token>\n";
+			break;
+		case SALVL_PROP_SHAREDSTRING:
+			xml << "<SharedString name=\"" << prop.name << "\">" << value.s << "</SharedString>\n";
+			break;
+		case SALVL_PROP_VECTOR3:
+			xml << "<Vector3 name = \"" << prop.name << "\">\n";
+			xml << "<X>" << value.f[0] << "</X>\n";
+			xml << "<Y>" << value.f[1] << "</Y>\n";
+			xml << "<Z>" << value.f[2] << "</Z>\n";
+			xml << "</Vector3>\n";
+			break;
+		case SALVL_PROP_CFRAME:
+		{
+			static const char *tags[12] = { "X", "Y", "Z", "R00", "R01", "R02", "R10", "R11", "R12", "R20", "R21", "R22" };
+			xml << "<CoordinateFrame name = \"" << prop.name << "\">\n";
+			for (int i = 0; i < 12; i++)
+				xml << "<" << tags[i] << ">" << value.f[i] << "</" << tags[i] << ">\n";
+			xml << "</CoordinateFrame>\n";
+			break;
+		}
+		case SALVL_PROP_COLOR3UINT8:
+			xml << "<Color3uint8 name = \"" << prop.name << "\">" << value.u << "</Color3uint8>\n";
+			break;
+	}
+}
+
+static void RBXMX_WriteMeshPart(SALVL_XMLWriter &xml, const SALVL_RBXMXPart &part)
+{
+	// MeshPart
+	const SALVL_MeshPart *meshpart = part.instance->meshpart;
+	Uint8 folder = part.collision ? SALVL_RBXMX_COLLISION : SALVL_RBXMX_VISUAL;
+
+	xml << "<Item class = \"MeshPart\">\n";
+	xml << "<Properties>\n";
+	for (auto &i : rbx_meshpart_properties)
+	{
+		if (!(i.folders & folder))
+			continue;
+		SALVL_PropertyValue value;
+		i.get(part, value);
+		RBXMX_WriteProperty(xml, i, value);
+	}
+	xml << "</Properties>\n";
+	if (RBXMX_HasTexture(meshpart) && meshpart->texture->alpha == SALVL_ALPHA_BLEND)
+	{
+		// SurfaceAppearance
+		xml << "<Item class = \"SurfaceAppearance\">\n";
+			xml << "<Properties>\n";
+				xml << "<token name=\"AlphaMode\">1</token>\n";
+				xml << "<Content name=\"ColorMap\"><url>" << meshpart->url_texture << "</url></Content>\n";
+			xml << "</Properties>\n";
+		xml << "</Item>\n";
+	}
+	xml << "</Item>\n";
+}
+
+static void RBXMX_WriteFolderStart(SALVL_XMLWriter &xml, std::string_view name)
+{
+	xml << "<Item class = \"Folder\">\n";
+	xml << "<Properties>\n";
+	xml << "<string name=\"Name\">" << name << "</string>\n";
+	xml << "</Properties>\n";
+}
+
+static bool RBXMX_Write(const std::string &path, const std::vector<SALVL_MeshPartInstance> &mesh_collision, const std::vector<SALVL_CSGMesh*> &collision_csgmesh, const std::vector<SALVL_MeshPartInstance> &mesh_visual, float scale)
+{
+	SALVL_XMLWriter stream_rbxmx;
+	if (!stream_rbxmx.Open(path))
+		return true;
+
+	// ROBLOX model tree
+	stream_rbxmx << "<roblox xmlns:xmime=\"http://www.w3.org/2005/05/xmlmime\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:noNamespaceSchemaLocation=\"http://www.roblox.com/roblox.xsd\" version=\"4\">\n";
+	RBXMX_WriteFolderStart(stream_rbxmx, "Level");
+	RBXMX_WriteFolderStart(stream_rbxmx, "Map");
+	RBXMX_WriteFolderStart(stream_rbxmx, "Collision");
+	for (size_t i = 0; i < mesh_collision.size(); i++)
+	{
+		SALVL_RBXMXPart part;
+		part.instance = &mesh_collision[i];
+		part.csgmesh = collision_csgmesh[i];
+		part.scale = scale;
+		part.collision = true;
+		RBXMX_WriteMeshPart(stream_rbxmx, part);
+	}
+	stream_rbxmx << "</Item>\n";
+	RBXMX_WriteFolderStart(stream_rbxmx, "Visual");
+	for (auto &i : mesh_visual)
+	{
+		SALVL_RBXMXPart part;
+		part.instance = &i;
+		part.scale = scale;
+		RBXMX_WriteMeshPart(stream_rbxmx, part);
+	}
+	stream_rbxmx << "</Item>\n";
+	stream_rbxmx << "</Item>\n";
+	stream_rbxmx << "</Item>\n";
+	// Shared Strings (CSGMesh hashes)
+	stream_rbxmx << "<SharedStrings>\n";
+	std::set<std::string> csgmesh_key;
+	for (auto &i : collision_csgmesh)
+	{
+		if (csgmesh_key.insert(i->enc_hash).second)
+			stream_rbxmx << "<SharedString md5=\"" << i->enc_hash << "\">" << i->enc_base64 << "</SharedString>\n";
+	}
+	stream_rbxmx << "</SharedStrings>\n";
+	stream_rbxmx << "</roblox>\n";
+	return !stream_rbxmx.Close();
+}
+
+// RBXM writer
+static void RBXM_LZ4Compress(const std::vector<Uint8> &in, std::vector<Uint8> &out)
+{
+	// Greedy LZ4 block compression with a single hash table
+	static const size_t min_match = 4, last_literals = 5, match_limit = 12;
+
+	const Uint8 *src = in.data();
+	size_t size = in.size();
+
+	out.clear();
+	out.reserve(size + size / 255 + 16);
+
+	auto write_length = [&](size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			out.push_back(255);
+		out.push_back((Uint8)length);
+	};
+
+	size_t anchor = 0;
+	if (size > match_limit)
+	{
+		std::vector<Sint32> table(1 << 16, -1);
+		size_t limit = size - match_limit;
+		size_t match_end = size - last_literals;
+
+		for (size_t i = 0; i < limit;)
+		{
+			// Find candidate match
+			Uint32 seq;
+			memcpy(&seq, src + i, 4);
+			Uint32 h = (seq * 2654435761U) >> 16;
+			Sint32 cand = table[h];
+			table[h] = (Sint32)i;
+
+			if (cand < 0 || (i - cand) > 0xFFFF || memcmp(src + cand, src + i, min_match) != 0)
+			{
+				i++;
+				continue;
+			}
+
+			size_t length = min_match;
+			while (i + length < match_end && src[cand + length] == src[i + length])
+				length++;
+
+			// Write sequence
+			size_t literals = i - anchor;
+			size_t match = length - min_match;
+			out.push_back((Uint8)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(match, 15)));
+			if (literals >= 15)
+				write_length(literals - 15);
+			out.insert(out.end(), src + anchor, src + i);
+
+			size_t offset = i - cand;
+			out.push_back((Uint8)offset);
+			out.push_back((Uint8)(offset >> 8));
+			if (match >= 15)
+				write_length(match - 15);
+
+			i += length;
+			anchor = i;
+		}
+	}
+
+	// Write last literals
+	size_t literals = size - anchor;
+	out.push_back((Uint8)(std::min<size_t>(literals, 15) << 4));
+	if (literals >= 15)
+		write_length(literals - 15);
+	out.insert(out.end(), src + anchor, src + size);
+}
+
+struct SALVL_RBXMBuffer
+{
+	// Chunk data
+	std::vector<Uint8> data;
+
+	void U8(Uint8 x) { data.push_back(x); }
+	void U32(Uint32 x) { U8((Uint8)x); U8((Uint8)(x >> 8)); U8((Uint8)(x >> 16)); U8((Uint8)(x >> 24)); }
+	void Bytes(const void *x, size_t size) { data.insert(data.end(), (const Uint8*)x, (const Uint8*)x + size); }
+	void String(std::string_view x) { U32((Uint32)x.size()); Bytes(x.data(), x.size()); }
+
+	void Interleaved(const std::vector<Uint32> &x)
+	{
+		// Big endian, most significant bytes of every value first
+		size_t base = data.size();
+		data.resize(base + x.size() * 4);
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			data[base + i] = (Uint8)(x[i] >> 24);
+			data[base + x.size() + i] = (Uint8)(x[i] >> 16);
+			data[base + x.size() * 2 + i] = (Uint8)(x[i] >> 8);
+			data[base + x.size() * 3 + i] = (Uint8)x[i];
+		}
+	}
+	void Ints(const std::vector<Sint32> &x)
+	{
+		std::vector<Uint32> zigzag(x.size());
+		for (size_t i = 0; i < x.size(); i++)
+			zigzag[i] = ((Uint32)x[i] << 1) ^ (Uint32)(x[i] >> 31);
+		Interleaved(zigzag);
+	}
+	void Floats(const std::vector<float> &x)
+	{
+		// Sign bit rotated to the bottom
+		std::vector<Uint32> rotated(x.size());
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			Uint32 bits;
+			memcpy(&bits, &x[i], 4);
+			rotated[i] = (bits << 1) | (bits >> 31);
+		}
+		Interleaved(rotated);
+	}
+	void Referents(const std::vector<Sint32> &x)
+	{
+		std::vector<Sint32> delta(x.size());
+		for (size_t i = 0; i < x.size(); i++)
+			delta[i] = x[i] - ((i != 0) ? x[i - 1] : 0);
+		Ints(delta);
+	}
+};
+
+#define RBXM_TYPE_STRING       0x01
+#define RBXM_TYPE_BOOL         0x02
+#define RBXM_TYPE_FLOAT        0x04
+#define RBXM_TYPE_VECTOR3      0x0E
+#define RBXM_TYPE_CFRAME       0x10
+#define RBXM_TYPE_TOKEN        0x12
+#define RBXM_TYPE_COLOR3UINT8  0x1A
+#define RBXM_TYPE_SHAREDSTRING 0x1C
+
+static void RBXM_WriteChunk(std::ofstream &stream, const char *name, const SALVL_RBXMBuffer &chunk, bool compress = true)
+{
+	// Compress if it helps
+	std::vector<Uint8> compressed;
+	if (compress)
+		RBXM_LZ4Compress(chunk.data, compressed);
+	bool use_compressed = compress && compressed.size() < chunk.data.size();
+
+	SALVL_RBXMBuffer header;
+	header.Bytes(name, 4);
+	header.U32(use_compressed ? (Uint32)compressed.size() : 0);
+	header.U32((Uint32)chunk.data.size());
+	header.U32(0);
+
+	stream.write((const char*)header.data.data(), header.data.size());
+	if (use_compressed)
+		stream.write((const char*)compressed.data(), compressed.size());
+	else
+		stream.write((const char*)chunk.data.data(), chunk.data.size());
+}
+
+static bool RBXM_Write(const std::string &path, const std::vector<SALVL_MeshPartInstance> &mesh_collision, const std::vector<SALVL_CSGMesh*> &collision_csgmesh, const std::vector<SALVL_MeshPartInstance> &mesh_visual, float scale)
+{
+	// Lay out instances: folders, then mesh parts, then surface appearances
+	static const char *folder_names[] = { "Level", "Map", "Collision", "Visual" };
+	static const Sint32 folder_parents[] = { -1, 0, 1, 1 };
+
+	std::vector<SALVL_RBXMXPart> parts;
+	for (size_t i = 0; i < mesh_collision.size(); i++)
+	{
+		SALVL_RBXMXPart part;
+		part.instance = &mesh_collision[i];
+		part.csgmesh = collision_csgmesh[i];
+		part.scale = scale;
+		part.collision = true;
+		parts.push_back(part);
+	}
+	for (auto &i : mesh_visual)
+	{
+		SALVL_RBXMXPart part;
+		part.instance = &i;
+		part.scale = scale;
+		parts.push_back(part);
+	}
+
+	std::vector<Sint32> folder_refs = { 0, 1, 2, 3 };
+	std::vector<Sint32> part_refs, part_parents;
+	std::vector<Sint32> appearance_refs, appearance_parents;
+	std::vector<const SALVL_MeshPart*> appearance_parts;
+
+	Sint32 next_ref = 4;
+	for (auto &i : parts)
+	{
+		part_refs.push_back(next_ref++);
+		part_parents.push_back(i.collision ? 2 : 3);
+	}
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		const SALVL_MeshPart *meshpart = parts[i].instance->meshpart;
+		if (RBXMX_HasTexture(meshpart) && meshpart->texture->alpha == SALVL_ALPHA_BLEND)
+		{
+			appearance_refs.push_back(next_ref++);
+			appearance_parents.push_back(part_refs[i]);
+			appearance_parts.push_back(meshpart);
+		}
+	}
+
+	// Shared strings, deduplicated by hash (index 0 is empty for visual parts)
+	SALVL_RBXMBuffer sstr;
+	std::unordered_map<std::string_view, Uint32> sstr_index;
+	{
+		std::vector<const SALVL_CSGMesh*> sstr_list;
+		for (auto &i : parts)
+		{
+			if (i.csgmesh == nullptr)
+				continue;
+			if (sstr_index.emplace(i.csgmesh->enc_hash, (Uint32)sstr_list.size() + 1).second)
+				sstr_list.push_back(i.csgmesh);
+		}
+
+		sstr.U32(0); // Version
+		sstr.U32((Uint32)sstr_list.size() + 1);
+		static const Uint8 empty_hash[16] = { 0xD4, 0x1D, 0x8C, 0xD9, 0x8F, 0x00, 0xB2, 0x04, 0xE9, 0x80, 0x09, 0x98, 0xEC, 0xF8, 0x42, 0x7E };
+		sstr.Bytes(empty_hash, 16);
+		sstr.String("");
+		for (auto &i : sstr_list)
+		{
+			sstr.Bytes(i->hash, 16);
+			sstr.U32((Uint32)i->data.size());
+			sstr.Bytes(i->data.data(), i->data.size());
+		}
+	}
+
+	// Classes
+	struct RBXM_Class
+	{
+		const char *name;
+		const std::vector<Sint32> *refs;
+	};
+	std::vector<RBXM_Class> classes;
+	Sint32 class_folder = -1, class_meshpart = -1, class_appearance = -1;
+
+	classes.push_back({ "Folder", &folder_refs });
+	class_folder = 0;
+	if (!part_refs.empty())
+	{
+		class_meshpart = (Sint32)classes.size();
+		classes.push_back({ "MeshPart", &part_refs });
+	}
+	if (!appearance_refs.empty())
+	{
+		class_appearance = (Sint32)classes.size();
+		classes.push_back({ "SurfaceAppearance", &appearance_refs });
+	}
+
+	// Open file and write header
+	std::ofstream stream(path, std::ios::binary);
+	if (!stream.is_open())
+		return true;
+
+	SALVL_RBXMBuffer header;
+	header.Bytes("<roblox!\x89\xFF\x0D\x0A\x1A\x0A", 14);
+	header.U8(0); header.U8(0); // Version
+	header.U32((Uint32)classes.size());
+	header.U32((Uint32)next_ref);
+	header.U32(0); header.U32(0); // Reserved
+	stream.write((const char*)header.data.data(), header.data.size());
+
+	RBXM_WriteChunk(stream, "SSTR", sstr);
+
+	for (size_t i = 0; i < classes.size(); i++)
+	{
+		SALVL_RBXMBuffer inst;
+		inst.U32((Uint32)i);
+		inst.String(classes[i].name);
+		inst.U8(0); // Not a service
+		inst.U32((Uint32)classes[i].refs->size());
+		inst.Referents(*classes[i].refs);
+		RBXM_WriteChunk(stream, "INST", inst);
+	}
+
+	// Property helpers
+	auto prop_begin = [](SALVL_RBXMBuffer &prop, Sint32 class_id, const char *name, Uint8 type)
+	{
+		prop.U32((Uint32)class_id);
+		prop.String(name);
+		prop.U8(type);
+	};
+	auto prop_strings = [&](Sint32 class_id, const char *name, const std::vector<std::string_view> &x)
+	{
+		SALVL_RBXMBuffer prop;
+		prop_begin(prop, class_id, name, RBXM_TYPE_STRING);
+		for (auto &i : x)
+			prop.String(i);
+		RBXM_WriteChunk(stream, "PROP", prop);
+	};
+	auto prop_tokens = [&](Sint32 class_id, const char *name, Uint8 type, const std::vector<Uint32> &x)
+	{
+		SALVL_RBXMBuffer prop;
+		prop_begin(prop, class_id, name, type);
+		prop.Interleaved(x);
+		RBXM_WriteChunk(stream, "PROP", prop);
+	};
+
+	// Folder properties
+	prop_strings(class_folder, "Name", { folder_names[0], folder_names[1], folder_names[2], folder_names[3] });
+
+	// MeshPart properties, one chunk per entry of the shared table
+	if (class_meshpart >= 0)
+	{
+		std::vector<SALVL_PropertyValue> values(parts.size());
+		auto floats = [&](int k)
+		{
+			std::vector<float> x;
+			for (auto &i : values)
+				x.push_back(i.f[k]);
+			return x;
+		};
+
+		for (auto &info : rbx_meshpart_properties)
+		{
+			for (size_t i = 0; i < parts.size(); i++)
+			{
+				values[i] = SALVL_PropertyValue();
+				if (info.folders & (parts[i].collision ? SALVL_RBXMX_COLLISION : SALVL_RBXMX_VISUAL))
+					info.get(parts[i], values[i]);
+			}
+
+			SALVL_RBXMBuffer prop;
+			switch (info.type)
+			{
+				case SALVL_PROP_BOOL:
+					prop_begin(prop, class_meshpart, info.name, RBXM_TYPE_BOOL);
+					for (auto &i : values)
+						prop.U8(i.u ? 1 : 0);
+					break;
+				case SALVL_PROP_FLOAT:
+					prop_begin(prop, class_meshpart, info.name, RBXM_TYPE_FLOAT);
+					prop.Floats(floats(0));
+					break;
+				case SALVL_PROP_STRING:
+				case SALVL_PROP_CONTENT:
+					prop_begin(prop, class_meshpart, info.name, RBXM_TYPE_STRING);
+					for (auto &i : values)
+						prop.String(i.s);
+					break;
+				case SALVL_PROP_TOKEN:
+				case SALVL_PROP_SHAREDSTRING:
+				{
+					std::vector<Uint32> x;
+					for (auto &i : values)
+					{
+						if (info.type == SALVL_PROP_TOKEN)
+						{
+							x.push_back(i.u);
+							continue;
+						}
+						auto it = sstr_index.find(i.s);
+						x.push_back((it != sstr_index.end()) ? it->second : 0);
+					}
+					prop_begin(prop, class_meshpart, info.name, (info.type == SALVL_PROP_TOKEN) ? RBXM_TYPE_TOKEN : RBXM_TYPE_SHAREDSTRING);
+					prop.Interleaved(x);
+					break;
+				}
+				case SALVL_PROP_VECTOR3:
+					prop_begin(prop, class_meshpart, info.name, RBXM_TYPE_VECTOR3);
+					for (int k = 0; k < 3; k++)
+						prop.Floats(floats(k));
+					break;
+				case SALVL_PROP_CFRAME:
+					// Full rotation matrices, then positions
+					prop_begin(prop, class_meshpart, info.name, RBXM_TYPE_CFRAME);
+					for (auto &i : values)
+					{
+						prop.U8(0);
+						prop.Bytes(i.f + 3, sizeof(float) * 9);
+					}
+					for (int k = 0; k < 3; k++)
+						prop.Floats(floats(k));
+					break;
+				case SALVL_PROP_COLOR3UINT8:
+					prop_begin(prop, class_meshpart, info.name, RBXM_TYPE_COLOR3UINT8);
+					for (int shift = 16; shift >= 0; shift -= 8)
+						for (auto &i : values)
+							prop.U8((Uint8)(i.u >> shift));
+					break;
+			}
+			RBXM_WriteChunk(stream, "PROP", prop);
+		}
+	}
+
+	// SurfaceAppearance properties
+	if (class_appearance >= 0)
+	{
+		std::vector<std::string_view> names, color_maps;
+		for (auto &i : appearance_parts)
+		{
+			names.push_back("SurfaceAppearance");
+			color_maps.push_back(i->url_texture);
+		}
+		prop_strings(class_appearance, "Name", names);
+		prop_tokens(class_appearance, "AlphaMode", RBXM_TYPE_TOKEN, std::vector<Uint32>(appearance_parts.size(), 1));
+		prop_strings(class_appearance, "ColorMap", color_maps);
+	}
+
+	// Parents
+	std::vector<Sint32> children, parents;
+	for (size_t i = 0; i < folder_refs.size(); i++)
+	{
+		children.push_back(folder_refs[i]);
+		parents.push_back(folder_parents[i]);
+	}
+	children.insert(children.end(), part_refs.begin(), part_refs.end());
+	parents.insert(parents.end(), part_parents.begin(), part_parents.end());
+	children.insert(children.end(), appearance_refs.begin(), appearance_refs.end());
+	parents.insert(parents.end(), appearance_parents.begin(), appearance_parents.end());
+
+	SALVL_RBXMBuffer prnt;
+	prnt.U8(0); // Version
+	prnt.U32((Uint32)children.size());
+	prnt.Referents(children);
+	prnt.Referents(parents);
+	RBXM_WriteChunk(stream, "PRNT", prnt);
+
+	// End
+	SALVL_RBXMBuffer end;
+	end.Bytes("</roblox>", 9);
+	RBXM_WriteChunk(stream, "END\0", end, false);
+
+	stream.close();
+	return stream.fail();
+}
+
+// Ninja reimplementation
+void Reimp_njRotateX(NJS_MATRIX cframe, Angle x)
+{
+	// Calculate the sine and cosine of our angle
+	Float sin = sinf((float)x * 3.14159265358979323846f / 0x8000);
+	Float cos = cosf((float)x * 3.14159265358979323846f / 0x8000);
+
+	// Apply rotation onto matrix
+	Float m10 = cframe[M10];
+	Float m11 = cframe[M11];
+	Float m12 = cframe[M12];
+	Float m13 = cframe[M13];
+
+	cframe[M10] = sin * cframe[M20] + m10 * cos;
+	cframe[M11] = sin * cframe[M21] + m11 * cos;
+	cframe[M12] = sin * cframe[M22] + m12 * cos;
+	cframe[M13] = sin * cframe[M23] + m13 * cos;
+	cframe[M20] = cos * cframe[M20] - m10 * sin;
+	cframe[M21] = cos * cframe[M21] - m11 * sin;
+	cframe[M22] = cos * cframe[M22] - m12 * sin;
+	cframe[M23] = cos * cframe[M23] - m13 * sin;
+}
+
+void Reimp_njRotateY(NJS_MATRIX cframe, Angle x)
+{
+	// Calculate the sine and cosine of our angle
+	Float sin = sinf((float)x * 3.14159265358979323846f / 0x8000);
+	Float cos = cosf((float)x * 3.14159265358979323846f / 0x8000);
+
+	// Apply rotation onto matrix
+	Float m00 = cframe[M00];
+	Float m01 = cframe[M01];
+	Float m02 = cframe[M02];
+	Float m03 = cframe[M03];
+
+	cframe[M00] = m00 * cos - sin * cframe[M20];
+	cframe[M01] = m01 * cos - sin * cframe[M21];
+	cframe[M02] = m02 * cos - sin * cframe[M22];
+	cframe[M03] = m03 * cos - sin * cframe[M23];
+	cframe[M20] = cos * cframe[M20] + m00 * sin;
+	cframe[M21] = cos * cframe[M21] + m01 * sin;
+	cframe[M22] = cos * cframe[M22] + m02 * sin;
+	cframe[M23] = cos * cframe[M23] + m03 * sin;
+}
+
+void Reimp_njRotateZ(NJS_MATRIX cframe, Angle x)
+{
+	// Calculate the sine and cosine of our angle
+	Float sin = sinf((float)x * 3.14159265358979323846f / 0x8000);
+	Float cos = cosf((float)x * 3.14159265358979323846f / 0x8000);
+
+	// Apply rotation onto matrix
+	Float m00 = cframe[M00];
+	Float m01 = cframe[M01];
+	Float m02 = cframe[M02];
+	Float m03 = cframe[M03];
+
+	cframe[M00] = m00 * cos + sin * cframe[M10];
+	cframe[M01] = m01 * cos + sin * cframe[M11];
+	cframe[M02] = m02 * cos + sin * cframe[M12];
+	cframe[M03] = m03 * cos + sin * cframe[M13];
+	cframe[M10] = cos * cframe[M10] - m00 * sin;
+	cframe[M11] = cos * cframe[M11] - m01 * sin;
+	cframe[M12] = cos * cframe[M12] - m02 * sin;
+	cframe[M13] = cos * cframe[M13] - m03 * sin;
+}
+
+// Parallel jobs
+void SALVL_ParallelFor(unsigned int jobs, size_t count, const std::function<void(size_t, unsigned int)> &func)
+{
+	// Run serially if there's nothing to spread
+	if (jobs > count)
+		jobs = (unsigned int)count;
+	if (jobs <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i, 0);
+		return;
+	}
+
+	// Each worker owns a range, taking from the front while thieves take from the back
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		size_t begin = 0, end = 0;
+	};
+	std::vector<WorkQueue> queues(jobs);
+	for (unsigned int w = 0; w < jobs; w++)
+	{
+		queues[w].begin = count * w / jobs;
+		queues[w].end = count * (w + 1) / jobs;
+	}
+
+	// The first exception thrown stops the workers and is rethrown on this thread
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	std::atomic<bool> failed(false);
+
+	auto worker = [&](unsigned int w)
+	{
+		WorkQueue &own = queues[w];
+		while (!failed)
+		{
+			// Take next index from own queue
+			size_t i = count;
+			{
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (own.begin < own.end)
+					i = own.begin++;
+			}
+			if (i != count)
+			{
+				try
+				{
+					func(i, w);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (error == nullptr)
+						error = std::current_exception();
+					failed = true;
+				}
+				continue;
+			}
+
+			// Steal the back half of another worker's queue
+			bool stole = false;
+			for (unsigned int o = 1; o < jobs && !stole; o++)
+			{
+				WorkQueue &victim = queues[(w + o) % jobs];
+				size_t steal_begin, steal_end;
+				{
+					std::lock_guard<std::mutex> lock(victim.mutex);
+					if (victim.begin >= victim.end)
+						continue;
+					steal_end = victim.end;
+					steal_begin = victim.begin + (victim.end - victim.begin) / 2;
+					victim.end = steal_begin;
+				}
+
+				std::lock_guard<std::mutex> lock(own.mutex);
+				own.begin = steal_begin;
+				own.end = steal_end;
+				stole = true;
+			}
+			if (!stole)
+				return;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int w = 1; w < jobs; w++)
+		threads.emplace_back(worker, w);
+	worker(0);
+	for (auto &i : threads)
+		i.join();
+
+	if (error != nullptr)
+		std::rethrow_exception(error);
+}
+
+void SALVL_ParallelFor(unsigned int jobs, size_t count, const std::function<void(size_t)> &func)
+{
+	SALVL_ParallelFor(jobs, count, [&](size_t i, unsigned int) { func(i); });
+}
+
+// Worker scratch
+#define SALVL_SCRATCH_FILE         0 // Source file contents
+#define SALVL_SCRATCH_RESAMPLE     1 // Resampler intermediate
+#define SALVL_SCRATCH_BASE         2 // Downscaled base image
+#define SALVL_SCRATCH_FU           3 // Flip variants
+#define SALVL_SCRATCH_FV           4
+#define SALVL_SCRATCH_FUV          5
+#define SALVL_SCRATCH_PNG_FILTERED 6 // Filtered rows before deflate
+#define SALVL_SCRATCH_PNG_INDICES  7 // Palette indices
+#define SALVL_SCRATCH_ATLAS        8 // Atlas page being composed
+#define SALVL_SCRATCH_COUNT        9
+
+struct SALVL_ScratchPool
+{
+	// Grow-only buffers owned by one worker and reused for every texture it handles
+	struct Buffer
+	{
+		std::unique_ptr<Uint8[]> data;
+		size_t size = 0;
+	};
+	Buffer buffers[SALVL_SCRATCH_COUNT];
+
+	Uint8 *Get(int slot, size_t size)
+	{
+		// Contents aren't kept when growing, returns null if out of memory
+		Buffer &buffer = buffers[slot];
+		if (size > buffer.size)
+		{
+			buffer.data.reset();
+			buffer.data.reset(new (std::nothrow) Uint8[size]);
+			buffer.size = (buffer.data != nullptr) ? size : 0;
+		}
+		return buffer.data.get();
+	}
+};
+
+// RBX mesh serialization
+#pragma pack(push, 1)
+struct SALVL_RBXMeshHeader
+{
+	Uint16 sizeof_header = sizeof(SALVL_RBXMeshHeader);
+	Uint8 sizeof_vertex = 0x28;
+	Uint8 sizeof_face = 0x0C;
+	Uint32 num_verts = 0;
+	Uint32 num_faces = 0;
+};
+
+struct SALVL_RBXMeshVertex
+{
+	float px, py, pz; // Position
+	float nx, ny, nz; // Normal
+	float tu, tv; // Texture
+	Sint8 tx, ty, tz, ts; // Tangent
+	Uint8 r, g, b, a; // RGBA tint
+};
+
+struct SALVL_RBXMeshFace
+{
+	Uint32 a, b, c;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SALVL_RBXMeshHeader) == 12, "SALVL_RBXMeshHeader size");
+static_assert(sizeof(SALVL_RBXMeshVertex) == 40, "SALVL_RBXMeshVertex size");
+static_assert(sizeof(SALVL_RBXMeshFace) == 12, "SALVL_RBXMeshFace size");
+
+void SALVL_SerializeRBXMesh(std::vector<char> &out, const SALVL_MeshPart &meshpart)
+{
+	// Size buffer exactly (version 2.00 mesh, little endian records)
+	static const char version[] = "version 2.00\n";
+	const size_t version_size = sizeof(version) - 1;
+
+	out.resize(version_size + sizeof(SALVL_RBXMeshHeader) + meshpart.vertex.size() * sizeof(SALVL_RBXMeshVertex) + meshpart.indices.size() * sizeof(SALVL_RBXMeshFace));
+	char *outp = out.data();
+
+	memcpy(outp, version, version_size);
+	outp += version_size;
+
+	// Write mesh header
+	SALVL_RBXMeshHeader header;
+	header.num_verts = (Uint32)meshpart.vertex.size();
+	header.num_faces = (Uint32)meshpart.indices.size();
+	memcpy(outp, &header, sizeof(header));
+	outp += sizeof(header);
+
+	// Write vertex data
+	for (auto &k : meshpart.vertex)
+	{
+		SALVL_RBXMeshVertex v = {
+			k.pos.x, k.pos.y, k.pos.z,
+			k.nor.x, k.nor.y, k.nor.z,
+			k.tex.x, k.tex.y,
+			0, 0, -127, 1,
+			k.r, k.g, k.b, k.a
+		};
+		memcpy(outp, &v, sizeof(v));
+		outp += sizeof(v);
+	}
+
+	// Write indices
+	for (auto &k : meshpart.indices)
+	{
+		SALVL_RBXMeshFace f = { k.i[0], k.i[1], k.i[2] };
+		memcpy(outp, &f, sizeof(f));
+		outp += sizeof(f);
+	}
+}
+
+
+// PNG writer
+struct SALVL_BitWriter
+{
+	// LSB first bit packing for deflate
+	std::vector<Uint8> &out;
+	std::uint64_t bits = 0;
+	int count = 0;
+
+	SALVL_BitWriter(std::vector<Uint8> &_out) : out(_out) {}
+
+	inline void Put(Uint32 value, int n)
+	{
+		bits |= (std::uint64_t)value << count;
+		count += n;
+		if (count >= 32)
+		{
+			Uint8 b[4] = { (Uint8)bits, (Uint8)(bits >> 8), (Uint8)(bits >> 16), (Uint8)(bits >> 24) };
+			out.insert(out.end(), b, b + 4);
+			bits >>= 32;
+			count -= 32;
+		}
+	}
+
+	void Align()
+	{
+		while (count > 0)
+		{
+			out.push_back((Uint8)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+		bits = 0;
+		count = 0;
+	}
+};
+
+struct SALVL_DeflateTables
+{
+	// Length and distance code lookups
+	Uint8 len_code[259]; // Length 3-258 to code - 257
+	Uint8 dist_code[32769]; // Distance 1-32768 to code
+
+	static constexpr Uint16 len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static constexpr Uint8 len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static constexpr Uint16 dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static constexpr Uint8 dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	SALVL_DeflateTables()
+	{
+		for (int c = 0; c < 29; c++)
+			for (int l = len_base[c]; l < ((c == 28) ? 259 : len_base[c + 1]); l++)
+				len_code[l] = (Uint8)c;
+		for (int c = 0; c < 30; c++)
+			for (int d = dist_base[c]; d < ((c == 29) ? 32769 : dist_base[c + 1]); d++)
+				dist_code[d] = (Uint8)c;
+	}
+};
+static const SALVL_DeflateTables deflate_tables;
+
+struct SALVL_DeflateToken
+{
+	Uint16 value; // Literal byte, or match length
+	Uint16 dist; // 0 for literals
+};
+
+static void Deflate_HuffmanLengths(const Uint32 *freq, int n, int max_bits, Uint8 *lengths)
+{
+	// Build Huffman code lengths, then limit them to max_bits
+	std::fill(lengths, lengths + n, (Uint8)0);
+
+	std::vector<int> syms;
+	for (int i = 0; i < n; i++)
+		if (freq[i] != 0)
+			syms.push_back(i);
+	for (int i = 0; syms.size() < 2; i++)
+		if (freq[i] == 0)
+			syms.push_back(i); // Trees must be complete, pad with an unused symbol
+	std::sort(syms.begin(), syms.end(), [&](int a, int b) { return freq[a] != freq[b] ? freq[a] < freq[b] : a < b; });
+
+	// Build tree, leaves first then internal nodes
+	std::vector<Uint32> node_freq;
+	std::vector<int> node_parent;
+	for (int i : syms)
+		node_freq.push_back(std::max<Uint32>(freq[i], 1));
+	node_parent.resize(node_freq.size(), -1);
+
+	typedef std::pair<Uint32, int> Node;
+	std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+	for (size_t i = 0; i < node_freq.size(); i++)
+		queue.push(Node(node_freq[i], (int)i));
+	while (queue.size() > 1)
+	{
+		Node a = queue.top(); queue.pop();
+		Node b = queue.top(); queue.pop();
+		int parent = (int)node_freq.size();
+		node_freq.push_back(a.first + b.first);
+		node_parent.push_back(-1);
+		node_parent[a.second] = parent;
+		node_parent[b.second] = parent;
+		queue.push(Node(a.first + b.first, parent));
+	}
+
+	// Count codes per depth, internal nodes come after their children
+	std::vector<int> depth(node_freq.size(), 0);
+	for (int i = (int)node_freq.size() - 2; i >= 0; i--)
+		depth[i] = depth[node_parent[i]] + 1;
+
+	int num_codes[32] = {};
+	for (size_t i = 0; i < syms.size(); i++)
+		num_codes[std::min(depth[i], 31)]++;
+
+	// Move overlong codes to max_bits and rebalance until the Kraft sum is exact
+	for (int i = max_bits + 1; i < 32; i++)
+	{
+		num_codes[max_bits] += num_codes[i];
+		num_codes[i] = 0;
+	}
+	Uint32 total = 0;
+	for (int i = max_bits; i > 0; i--)
+		total += (Uint32)num_codes[i] << (max_bits - i);
+	while (total != (1U << max_bits))
+	{
+		num_codes[max_bits]--;
+		for (int i = max_bits - 1; i > 0; i--)
+		{
+			if (num_codes[i])
+			{
+				num_codes[i]--;
+				num_codes[i + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	// Most frequent symbols get the shortest codes
+	size_t j = syms.size();
+	for (int i = 1; i <= max_bits; i++)
+		for (int k = num_codes[i]; k > 0; k--)
+			lengths[syms[--j]] = (Uint8)i;
+}
+
+static void Deflate_HuffmanCodes(const Uint8 *lengths, int n, Uint16 *codes)
+{
+	// Canonical codes, bit reversed for LSB first output
+	int bl_count[16] = {};
+	for (int i = 0; i < n; i++)
+		bl_count[lengths[i]]++;
+	bl_count[0] = 0;
+
+	int next_code[16] = {};
+	for (int bits = 1, code = 0; bits < 16; bits++)
+	{
+		code = (code + bl_count[bits - 1]) << 1;
+		next_code[bits] = code;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		if (lengths[i] == 0)
+			continue;
+		int code = next_code[lengths[i]]++, rev = 0;
+		for (int b = 0; b < lengths[i]; b++)
+			rev |= ((code >> b) & 1) << (lengths[i] - b - 1);
+		codes[i] = (Uint16)rev;
+	}
+}
+
+static void Deflate_WriteBlock(SALVL_BitWriter &bw, const SALVL_DeflateToken *tokens, size_t num_tokens, bool final)
+{
+	// Get symbol frequencies
+	Uint32 lit_freq[286] = {}, dist_freq[30] = {};
+	for (size_t i = 0; i < num_tokens; i++)
+	{
+		if (tokens[i].dist == 0)
+		{
+			lit_freq[tokens[i].value]++;
+		}
+		else
+		{
+			lit_freq[257 + deflate_tables.len_code[tokens[i].value]]++;
+			dist_freq[deflate_tables.dist_code[tokens[i].dist]]++;
+		}
+	}
+	lit_freq[256] = 1;
+
+	Uint8 lit_len[286], dist_len[30];
+	Uint16 lit_code[286] = {}, dist_code[30] = {};
+	Deflate_HuffmanLengths(lit_freq, 286, 15, lit_len);
+	Deflate_HuffmanLengths(dist_freq, 30, 15, dist_len);
+	Deflate_HuffmanCodes(lit_len, 286, lit_code);
+	Deflate_HuffmanCodes(dist_len, 30, dist_code);
+
+	int hlit = 286, hdist = 30;
+	while (hlit > 257 && lit_len[hlit - 1] == 0)
+		hlit--;
+	while (hdist > 1 && dist_len[hdist - 1] == 0)
+		hdist--;
+
+	// Run length encode the code lengths
+	Uint8 all_len[286 + 30];
+	memcpy(all_len, lit_len, hlit);
+	memcpy(all_len + hlit, dist_len, hdist);
+	int all_num = hlit + hdist;
+
+	std::vector<std::pair<Uint8, Uint8>> cl_syms; // Symbol, extra bits value
+	Uint32 cl_freq[19] = {};
+	for (int i = 0; i < all_num;)
+	{
+		int run = 1;
+		while (i + run < all_num && all_len[i + run] == all_len[i])
+			run++;
+
+		if (all_len[i] == 0 && run >= 3)
+		{
+			run = std::min(run, 138);
+			if (run >= 11)
+				cl_syms.push_back({ 18, (Uint8)(run - 11) });
+			else
+				cl_syms.push_back({ 17, (Uint8)(run - 3) });
+		}
+		else if (all_len[i] != 0 && run >= 4)
+		{
+			run = std::min(run, 7);
+			cl_syms.push_back({ all_len[i], 0 });
+			cl_syms.push_back({ 16, (Uint8)(run - 4) });
+		}
+		else
+		{
+			run = 1;
+			cl_syms.push_back({ all_len[i], 0 });
+		}
+		i += run;
+	}
+	for (auto &i : cl_syms)
+		cl_freq[i.first]++;
+
+	Uint8 cl_len[19];
+	Uint16 cl_code[19] = {};
+	Deflate_HuffmanLengths(cl_freq, 19, 7, cl_len);
+	Deflate_HuffmanCodes(cl_len, 19, cl_code);
+
+	static const Uint8 cl_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	int hclen = 19;
+	while (hclen > 4 && cl_len[cl_order[hclen - 1]] == 0)
+		hclen--;
+
+	// Write dynamic block header
+	bw.Put(final ? 1 : 0, 1);
+	bw.Put(2, 2);
+	bw.Put(hlit - 257, 5);
+	bw.Put(hdist - 1, 5);
+	bw.Put(hclen - 4, 4);
+	for (int i = 0; i < hclen; i++)
+		bw.Put(cl_len[cl_order[i]], 3);
+	for (auto &i : cl_syms)
+	{
+		bw.Put(cl_code[i.first], cl_len[i.first]);
+		if (i.first == 16)
+			bw.Put(i.second, 2);
+		else if (i.first == 17)
+			bw.Put(i.second, 3);
+		else if (i.first == 18)
+			bw.Put(i.second, 7);
+	}
+
+	// Write tokens
+	for (size_t i = 0; i < num_tokens; i++)
+	{
+		const SALVL_DeflateToken &token = tokens[i];
+		if (token.dist == 0)
+		{
+			bw.Put(lit_code[token.value], lit_len[token.value]);
+		}
+		else
+		{
+			int lc = deflate_tables.len_code[token.value];
+			bw.Put(lit_code[257 + lc], lit_len[257 + lc]);
+			bw.Put(token.value - SALVL_DeflateTables::len_base[lc], SALVL_DeflateTables::len_extra[lc]);
+
+			int dc = deflate_tables.dist_code[token.dist];
+			bw.Put(dist_code[dc], dist_len[dc]);
+			bw.Put(token.dist - SALVL_DeflateTables::dist_base[dc], SALVL_DeflateTables::dist_extra[dc]);
+		}
+	}
+	bw.Put(lit_code[256], lit_len[256]);
+}
+
+static void Deflate_Unit(std::vector<Uint8> &out, const Uint8 *data, size_t size, int effort, bool final)
+{
+	// Compress one independent unit of raw deflate, ending byte aligned
+	SALVL_BitWriter bw(out);
+
+	if (effort <= 0)
+	{
+		// Stored blocks
+		size_t pos = 0;
+		do
+		{
+			size_t len = std::min<size_t>(size - pos, 0xFFFF);
+			bool last = final && (pos + len == size);
+			bw.Put(last ? 1 : 0, 1);
+			bw.Put(0, 2);
+			bw.Align();
+			out.push_back((Uint8)len);
+			out.push_back((Uint8)(len >> 8));
+			out.push_back((Uint8)~len);
+			out.push_back((Uint8)(~len >> 8));
+			out.insert(out.end(), data + pos, data + pos + len);
+			pos += len;
+		} while (pos < size);
+		if (!final)
+		{
+			// Empty stored block so the next unit starts on a byte boundary
+			bw.Put(0, 3);
+			bw.Align();
+			out.insert(out.end(), { 0x00, 0x00, 0xFF, 0xFF });
+		}
+		return;
+	}
+
+	// Match finder settings by effort
+	static const int chain_limits[10] = { 0, 2, 4, 8, 16, 32, 64, 128, 256, 1024 };
+	int chain_limit = chain_limits[std::min(effort, 9)];
+	int nice_len = (effort < 4) ? 32 : 258;
+	bool lazy = effort >= 4;
+
+	static const int hash_bits = 15;
+	std::vector<Sint32> head((size_t)1 << hash_bits, -1);
+	std::vector<Sint32> prev(size);
+	auto hash = [&](size_t i)
+	{
+		return (((Uint32)data[i] | (Uint32)data[i + 1] << 8 | (Uint32)data[i + 2] << 16) * 2654435761U) >> (32 - hash_bits);
+	};
+	auto insert = [&](size_t i)
+	{
+		if (i + 3 > size)
+			return;
+		Uint32 h = hash(i);
+		prev[i] = head[h];
+		head[h] = (Sint32)i;
+	};
+	auto find = [&](size_t i, int &best_dist, int chain_limit)
+	{
+		int best_len = 0;
+		if (i + 3 > size)
+			return best_len;
+		int max_len = (int)std::min<size_t>(258, size - i);
+		Sint32 cand = head[hash(i)];
+		for (int chain = chain_limit; cand >= 0 && chain > 0 && (i - cand) <= 32768; chain--, cand = prev[cand])
+		{
+			const Uint8 *a = data + cand, *b = data + i;
+			if (a[best_len] != b[best_len] || a[0] != b[0])
+				continue;
+			int len = 0;
+			while (len < max_len && a[len] == b[len])
+				len++;
+			if (len > best_len)
+			{
+				best_len = len;
+				best_dist = (int)(i - cand);
+				if (len >= nice_len || len == max_len)
+					break;
+			}
+		}
+		return (best_len >= 3) ? best_len : 0;
+	};
+
+	// Tokenize and write blocks as they fill
+	static const size_t block_tokens = 0x8000;
+	std::vector<SALVL_DeflateToken> tokens;
+	tokens.reserve(block_tokens);
+
+	size_t misses = 0;
+	for (size_t i = 0; i < size;)
+	{
+		// Incompressible runs are skipped through faster the longer they go on
+		if (!lazy && misses >= 64)
+		{
+			size_t skip = std::min<size_t>(misses >> 6, size - i);
+			for (size_t k = 0; k < skip; k++)
+				tokens.push_back({ data[i + k], 0 });
+			i += skip;
+			misses++;
+			if (i >= size)
+				break;
+		}
+
+		int dist = 0, len = find(i, dist, chain_limit);
+		if (len != 0 && lazy && len < nice_len && i + 1 < size)
+		{
+			// Prefer a longer match starting one byte later, searching less hard if this one is already good
+			int next_dist = 0;
+			insert(i);
+			int next_len = find(i + 1, next_dist, (len >= 8) ? std::max(chain_limit >> 2, 1) : chain_limit);
+			if (next_len > len)
+			{
+				tokens.push_back({ data[i], 0 });
+				i++;
+				len = next_len;
+				dist = next_dist;
+			}
+			else
+			{
+				// Undo insert, it's redone below
+				head[hash(i)] = prev[i];
+			}
+		}
+
+		if (len != 0)
+		{
+			tokens.push_back({ (Uint16)len, (Uint16)dist });
+			for (int k = 0; k < len; k++)
+				insert(i + k);
+			i += len;
+			misses = 0;
+		}
+		else
+		{
+			tokens.push_back({ data[i], 0 });
+			insert(i);
+			i++;
+			misses++;
+		}
+
+		if (tokens.size() >= block_tokens && i < size)
+		{
+			Deflate_WriteBlock(bw, tokens.data(), tokens.size(), false);
+			tokens.clear();
+		}
+	}
+	Deflate_WriteBlock(bw, tokens.data(), tokens.size(), final);
+
+	if (!final)
+	{
+		// Empty stored block so the next unit starts on a byte boundary
+		bw.Put(0, 3);
+		bw.Align();
+		out.insert(out.end(), { 0x00, 0x00, 0xFF, 0xFF });
+	}
+	else
+	{
+		bw.Align();
+	}
+}
+
+static Uint32 Adler32(const Uint8 *data, size_t size)
+{
+	Uint32 a = 1, b = 0;
+	while (size > 0)
+	{
+		size_t n = std::min<size_t>(size, 5552);
+		size -= n;
+		while (n--)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+static Uint32 Adler32Combine(Uint32 adler1, Uint32 adler2, size_t size2)
+{
+	// Checksum of two concatenated buffers from their individual checksums
+	static const Uint32 base = 65521;
+	Uint32 rem = (Uint32)(size2 % base);
+	Uint32 sum1 = adler1 & 0xFFFF;
+	Uint32 sum2 = (Uint32)(((std::uint64_t)rem * sum1) % base);
+	sum1 += (adler2 & 0xFFFF) + base - 1;
+	sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + base - rem;
+	if (sum1 >= base) sum1 -= base;
+	if (sum1 >= base) sum1 -= base;
+	if (sum2 >= (base << 1)) sum2 -= (base << 1);
+	if (sum2 >= base) sum2 -= base;
+	return sum1 | (sum2 << 16);
+}
+
+static Uint32 CRC32(const Uint8 *data, size_t size, Uint32 crc = 0)
+{
+	static const auto table = []()
+	{
+		std::array<Uint32, 256> t;
+		for (Uint32 i = 0; i < 256; i++)
+		{
+			Uint32 c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static inline Uint8 PNG_Paeth(int a, int b, int c)
+{
+	int pp = a + b - c, pa = abs(pp - a), pb = abs(pp - b), pc = abs(pp - c);
+	if (pa <= pb && pa <= pc)
+		return (Uint8)a;
+	return (Uint8)((pb <= pc) ? b : c);
+}
+
+static void PNG_FilterRowType(Uint8 *out, const Uint8 *row, const Uint8 *up, size_t p, int filter)
+{
+	// Apply one filter type, up is a zeroed row for the first row
+	switch (filter)
+	{
+		case 0:
+			memcpy(out, row, p);
+			break;
+		case 1:
+			memcpy(out, row, 4);
+			for (size_t i = 4; i < p; i++)
+				out[i] = (Uint8)(row[i] - row[i - 4]);
+			break;
+		case 2:
+			for (size_t i = 0; i < p; i++)
+				out[i] = (Uint8)(row[i] - up[i]);
+			break;
+		case 3:
+			for (size_t i = 0; i < 4; i++)
+				out[i] = (Uint8)(row[i] - (up[i] >> 1));
+			for (size_t i = 4; i < p; i++)
+				out[i] = (Uint8)(row[i] - ((row[i - 4] + up[i]) >> 1));
+			break;
+		case 4:
+			for (size_t i = 0; i < 4; i++)
+				out[i] = (Uint8)(row[i] - up[i]);
+			for (size_t i = 4; i < p; i++)
+				out[i] = (Uint8)(row[i] - PNG_Paeth(row[i - 4], up[i], up[i - 4]));
+			break;
+	}
+}
+
+static void PNG_FilterRow(Uint8 *out, const Uint8 *row, const Uint8 *prev_row, size_t p, int effort, std::vector<Uint8> &scratch)
+{
+	// Choose a filter per row by minimum sum of absolute residuals
+	if (effort <= 0)
+	{
+		out[0] = 0;
+		memcpy(out + 1, row, p);
+		return;
+	}
+
+	// Flat rows skip the heuristic, Up (or Sub on the first row) leaves only zeros
+	if (prev_row != nullptr && memcmp(row, prev_row, p) == 0)
+	{
+		out[0] = 2;
+		memset(out + 1, 0, p);
+		return;
+	}
+	if (prev_row == nullptr && p >= 4 && memcmp(row, row + 4, p - 4) == 0)
+	{
+		out[0] = 1;
+		PNG_FilterRowType(out + 1, row, nullptr, p, 1);
+		return;
+	}
+
+	scratch.resize(p * 2);
+	Uint8 *zero = scratch.data(), *test = scratch.data() + p;
+	if (prev_row == nullptr)
+	{
+		memset(zero, 0, p);
+		prev_row = zero;
+	}
+
+	Uint32 best_sum = UINT32_MAX;
+	int best_filter = 0;
+	for (int f = 0; f < 5; f++)
+	{
+		PNG_FilterRowType(test, row, prev_row, p, f);
+		Uint32 sum = 0;
+		for (size_t i = 0; i < p; i++)
+			sum += (Uint32)abs((int)(Sint8)test[i]);
+		if (sum < best_sum)
+		{
+			best_sum = sum;
+			best_filter = f;
+		}
+	}
+
+	out[0] = (Uint8)best_filter;
+	PNG_FilterRowType(out + 1, row, prev_row, p, best_filter);
+}
+
+static bool PNG_Palette(const Uint8 *pixels, size_t count, std::vector<Uint32> &palette, Uint8 *indices)
+{
+	// Collect the distinct colours of an image, giving up as soon as there are more than 256
+	Uint32 key[512];
+	Sint16 slot[512];
+	std::fill(slot, slot + 512, -1);
+	auto find = [&](Uint32 c)
+	{
+		Uint32 h = (c * 0x9E3779B1U) >> 23;
+		while (slot[h] >= 0 && key[h] != c)
+			h = (h + 1) & 511;
+		return h;
+	};
+
+	palette.clear();
+	Uint32 prev = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		Uint32 c;
+		memcpy(&c, pixels + i * 4, 4);
+		if (i != 0 && c == prev)
+			continue;
+		prev = c;
+
+		Uint32 h = find(c);
+		if (slot[h] < 0)
+		{
+			if (palette.size() == 256)
+				return true;
+			key[h] = c;
+			slot[h] = 0;
+			palette.push_back(c);
+		}
+	}
+
+	// Translucent entries first so tRNS can stop at the last of them
+	auto opaque = [](Uint32 c) { return ((const Uint8*)&c)[3] == 0xFF; };
+	std::sort(palette.begin(), palette.end(), [&](Uint32 a, Uint32 b) { return opaque(a) != opaque(b) ? opaque(b) : a < b; });
+	for (size_t i = 0; i < palette.size(); i++)
+		slot[find(palette[i])] = (Sint16)i;
+
+	// Map pixels to palette indices
+	Uint8 prev_index = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		Uint32 c;
+		memcpy(&c, pixels + i * 4, 4);
+		if (i == 0 || c != prev)
+			prev_index = (Uint8)slot[find(c)];
+		prev = c;
+		indices[i] = prev_index;
+	}
+	return false;
+}
+
+static void PNG_PackRow(Uint8 *out, const Uint8 *indices, int w, int depth)
+{
+	// Pack palette indices into bytes, leftmost pixel in the high bits
+	if (depth == 8)
+	{
+		memcpy(out, indices, w);
+		return;
+	}
+	int per_byte = 8 / depth;
+	for (int x = 0; x < w; x += per_byte)
+	{
+		Uint8 byte = 0;
+		for (int i = 0; i < per_byte; i++)
+			byte = (Uint8)((byte << depth) | ((x + i < w) ? indices[x + i] : 0));
+		*out++ = byte;
+	}
+}
+
+static bool PNG_Write(const std::string &path, const Uint8 *pixels, int w, int h, int effort, unsigned int jobs, SALVL_ScratchPool &scratch_pool)
+{
+	// Encode RGBA8 as PNG, filtering and deflating blocks of rows in parallel
+	// Images with 256 colours or less are written indexed, at the smallest bit depth that holds their palette
+	std::vector<Uint32> palette;
+	Uint8 *indices = scratch_pool.Get(SALVL_SCRATCH_PNG_INDICES, (size_t)w * h);
+	if (indices == nullptr)
+		return true;
+	bool indexed = !PNG_Palette(pixels, (size_t)w * h, palette, indices);
+	int depth = 8;
+	if (indexed)
+		depth = (palette.size() <= 2) ? 1 : (palette.size() <= 4) ? 2 : (palette.size() <= 16) ? 4 : 8;
+
+	size_t p = indexed ? (((size_t)w * depth + 7) / 8) : ((size_t)w * 4);
+	size_t row_size = p + 1;
+
+	static const size_t unit_target = 0x40000;
+	size_t unit_rows = std::max<size_t>(1, unit_target / row_size);
+	size_t units = ((size_t)h + unit_rows - 1) / unit_rows;
+
+	Uint8 *filtered = scratch_pool.Get(SALVL_SCRATCH_PNG_FILTERED, row_size * h);
+	if (filtered == nullptr)
+		return true;
+	std::vector<std::vector<Uint8>> unit_out(units);
+	std::vector<Uint32> unit_adler(units);
+
+	SALVL_ParallelFor(jobs, units, [&](size_t u)
+	{
+		size_t y0 = u * unit_rows, y1 = std::min<size_t>(y0 + unit_rows, h);
+		std::vector<Uint8> scratch;
+		for (size_t y = y0; y < y1; y++)
+		{
+			if (indexed)
+			{
+				// Indices aren't continuous, so palette rows are left unfiltered
+				filtered[row_size * y] = 0;
+				PNG_PackRow(filtered + row_size * y + 1, indices + (size_t)w * y, w, depth);
+			}
+			else
+			{
+				PNG_FilterRow(filtered + row_size * y, pixels + p * y, (y != 0) ? (pixels + p * (y - 1)) : nullptr, p, effort, scratch);
+			}
+		}
+
+		const Uint8 *data = filtered + row_size * y0;
+		size_t size = row_size * (y1 - y0);
+		unit_adler[u] = Adler32(data, size);
+		Deflate_Unit(unit_out[u], data, size, effort, u + 1 == units);
+	});
+
+	// Join units into one zlib stream
+	std::vector<Uint8> idat = { 'I', 'D', 'A', 'T', 0x78, 0x01 };
+	Uint32 adler = 1;
+	for (size_t u = 0; u < units; u++)
+	{
+		size_t y0 = u * unit_rows, y1 = std::min<size_t>(y0 + unit_rows, h);
+		adler = Adler32Combine(adler, unit_adler[u], row_size * (y1 - y0));
+		idat.insert(idat.end(), unit_out[u].begin(), unit_out[u].end());
+		std::vector<Uint8>().swap(unit_out[u]);
+	}
+	Push32BE(idat, adler);
+
+	// Write chunks
+	std::ofstream stream(path, std::ios::binary);
+	if (!stream.is_open())
+		return true;
+
+	auto write_chunk = [&](const std::vector<Uint8> &chunk)
+	{
+		// Chunk is type followed by data
+		std::vector<Uint8> head, tail;
+		Push32BE(head, (Uint32)(chunk.size() - 4));
+		Push32BE(tail, CRC32(chunk.data(), chunk.size()));
+		stream.write((const char*)head.data(), head.size());
+		stream.write((const char*)chunk.data(), chunk.size());
+		stream.write((const char*)tail.data(), tail.size());
+	};
+
+	static const Uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	stream.write((const char*)signature, 8);
+
+	std::vector<Uint8> ihdr = { 'I', 'H', 'D', 'R' };
+	Push32BE(ihdr, (Uint32)w);
+	Push32BE(ihdr, (Uint32)h);
+	if (indexed)
+		ihdr.insert(ihdr.end(), { (Uint8)depth, 3, 0, 0, 0 }); // Palette, deflate, adaptive filtering, no interlace
+	else
+		ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, deflate, adaptive filtering, no interlace
+	write_chunk(ihdr);
+
+	if (indexed)
+	{
+		// Palette, with alpha up to the last translucent entry
+		std::vector<Uint8> plte = { 'P', 'L', 'T', 'E' }, trns = { 't', 'R', 'N', 'S' };
+		for (auto &i : palette)
+		{
+			const Uint8 *c = (const Uint8*)&i;
+			plte.insert(plte.end(), { c[0], c[1], c[2] });
+			if (c[3] != 0xFF)
+				trns.push_back(c[3]);
+		}
+		write_chunk(plte);
+		if (trns.size() > 4)
+			write_chunk(trns);
+	}
+	write_chunk(idat);
+	write_chunk({ 'I', 'E', 'N', 'D' });
+
+	return !stream.good();
+}
+
+// Texture resampling
+static void Texture_VariantRes(int w, int h, int variant, int max_res, int &vw, int &vh)
+{
+	// Fit a variant within max_res, scaling the base image it's mirrored from
+	int fx = (variant & 1) ? 2 : 1, fy = (variant & 2) ? 2 : 1;
+	int bw = w, bh = h;
+	if (max_res > 0 && std::max(w * fx, h * fy) > max_res)
+	{
+		double scale = (double)max_res / std::max(w * fx, h * fy);
+		bw = std::min(std::max(1, (int)(w * scale + 0.5)), std::max(1, max_res / fx));
+		bh = std::min(std::max(1, (int)(h * scale + 0.5)), std::max(1, max_res / fy));
+	}
+	vw = bw * fx;
+	vh = bh * fy;
+}
+
+static float MitchellFilter(float x)
+{
+	// Mitchell-Netravali, B = C = 1/3
+	x = fabsf(x);
+	if (x < 1.0f)
+		return (7.0f * x * x * x - 12.0f * x * x + 16.0f / 3.0f) / 6.0f;
+	if (x < 2.0f)
+		return (-7.0f / 3.0f * x * x * x + 12.0f * x * x - 20.0f * x + 32.0f / 3.0f) / 6.0f;
+	return 0.0f;
+}
+
+static bool ResampleRGBA8(const Uint8 *src, int sw, int sh, Uint8 *dst, int dw, int dh, SALVL_ScratchPool &scratch_pool)
+{
+	// Separable resample on premultiplied alpha, so transparent texels don't darken their neighbours
+	struct Tap
+	{
+		int index;
+		float weight;
+	};
+	auto taps = [](int src_size, int dst_size, std::vector<int> &start, std::vector<Tap> &tap)
+	{
+		float scale = (float)src_size / dst_size;
+		float filter_scale = std::max(scale, 1.0f);
+		float support = 2.0f * filter_scale;
+		for (int i = 0; i < dst_size; i++)
+		{
+			float center = (i + 0.5f) * scale;
+			int j0 = (int)floorf(center - support), j1 = (int)ceilf(center + support);
+			float total = 0.0f;
+
+			start.push_back((int)tap.size());
+			for (int j = j0; j <= j1; j++)
+			{
+				float weight = MitchellFilter((j + 0.5f - center) / filter_scale);
+				if (weight == 0.0f)
+					continue;
+				tap.push_back({ std::min(std::max(j, 0), src_size - 1), weight });
+				total += weight;
+			}
+			for (size_t k = start.back(); k < tap.size(); k++)
+				tap[k].weight /= total;
+		}
+		start.push_back((int)tap.size());
+	};
+
+	std::vector<int> x_start, y_start;
+	std::vector<Tap> x_tap, y_tap;
+	taps(sw, dw, x_start, x_tap);
+	taps(sh, dh, y_start, y_tap);
+
+	// Intermediate rows share one scratch buffer
+	size_t premul_size = (size_t)sw * 4, horz_size = (size_t)dw * sh * 4, col_size = (size_t)dw * 4;
+	float *premul = (float*)scratch_pool.Get(SALVL_SCRATCH_RESAMPLE, (premul_size + horz_size + col_size) * sizeof(float));
+	if (premul == nullptr)
+		return true;
+	float *horz = premul + premul_size, *col = horz + horz_size;
+
+	// Horizontal pass into premultiplied floats
+	for (int y = 0; y < sh; y++)
+	{
+		const Uint8 *row = src + (size_t)y * sw * 4;
+		for (int x = 0; x < sw; x++)
+		{
+			float a = row[x * 4 + 3] / 255.0f;
+			premul[x * 4 + 0] = row[x * 4 + 0] * a;
+			premul[x * 4 + 1] = row[x * 4 + 1] * a;
+			premul[x * 4 + 2] = row[x * 4 + 2] * a;
+			premul[x * 4 + 3] = row[x * 4 + 3];
+		}
+
+		float *out = horz + (size_t)y * dw * 4;
+		for (int x = 0; x < dw; x++)
+		{
+			float c[4] = {};
+			for (int k = x_start[x]; k < x_start[x + 1]; k++)
+				for (int ch = 0; ch < 4; ch++)
+					c[ch] += premul[x_tap[k].index * 4 + ch] * x_tap[k].weight;
+			memcpy(out + x * 4, c, sizeof(c));
+		}
+	}
+
+	// Vertical pass, then unpremultiply
+	for (int y = 0; y < dh; y++)
+	{
+		std::fill(col, col + col_size, 0.0f);
+		for (int k = y_start[y]; k < y_start[y + 1]; k++)
+		{
+			const float *row = horz + (size_t)y_tap[k].index * dw * 4;
+			float weight = y_tap[k].weight;
+			for (size_t i = 0; i < col_size; i++)
+				col[i] += row[i] * weight;
+		}
+
+		Uint8 *out = dst + (size_t)y * dw * 4;
+		for (int x = 0; x < dw; x++)
+		{
+			float a = std::min(std::max(col[x * 4 + 3], 0.0f), 255.0f);
+			float unpremul = (a > 0.0f) ? (255.0f / a) : 0.0f;
+			for (int ch = 0; ch < 3; ch++)
+				out[x * 4 + ch] = (Uint8)(std::min(std::max(col[x * 4 + ch] * unpremul, 0.0f), 255.0f) + 0.5f);
+			out[x * 4 + 3] = (Uint8)(a + 0.5f);
+		}
+	}
+	return false;
+}
+
+// Texture mirroring
+static void MirrorRowRGBA8(Uint8 *dst, const Uint8 *src, int w)
+{
+	// dst[x] = src[w - x - 1], one RGBA8 pixel at a time
+	int x = 0;
+#ifdef SALVL_SSE2
+	for (; x + 4 <= w; x += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + (w - x - 4) * 4));
+		_mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+	}
+#endif
+	for (; x < w; x++)
+		memcpy(dst + x * 4, src + (w - x - 1) * 4, 4);
+}
+
+void MirrorRGBA8(const Uint8 *src, int w, int h, Uint8 *fu, Uint8 *fv, Uint8 *fuv)
+{
+	// Build the U (2w x h), V (w x 2h) and UV (2w x 2h) mirrors in one pass over the source rows, any output may be null
+	size_t p = (size_t)w * 4;
+	std::vector<Uint8> scratch;
+	if (fu == nullptr && fuv != nullptr)
+		scratch.resize(p * 2);
+
+	for (int y = 0; y < h; y++)
+	{
+		const Uint8 *row = src + p * y;
+		size_t y_mirror = (size_t)h * 2 - y - 1;
+
+		if (fv != nullptr)
+		{
+			memcpy(fv + p * y, row, p);
+			memcpy(fv + p * y_mirror, row, p);
+		}
+
+		if (fu != nullptr || fuv != nullptr)
+		{
+			Uint8 *row_u = (fu != nullptr) ? (fu + p * 2 * y) : scratch.data();
+			memcpy(row_u, row, p);
+			MirrorRowRGBA8(row_u + p, row, w);
+
+			if (fuv != nullptr)
+			{
+				memcpy(fuv + p * 2 * y, row_u, p * 2);
+				memcpy(fuv + p * 2 * y_mirror, row_u, p * 2);
+			}
+		}
+	}
+}
+
+// Texture alpha
+static Uint8 ClassifyAlphaRGBA8(const Uint8 *src, size_t pixels)
+{
+	// Opaque until a clear texel is seen, blend as soon as a partial one is
+	Uint8 alpha = SALVL_ALPHA_OPAQUE;
+	size_t i = 0;
+#ifdef SALVL_SSE2
+	const __m128i mask = _mm_set1_epi32((int)0xFF000000);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_cmpeq_epi32(zero, zero);
+	for (; i + 16 <= pixels; i += 16)
+	{
+		// 16 texels at a time, isolating the alpha byte of each
+		__m128i opaque = ones, binary = ones;
+		for (int j = 0; j < 4; j++)
+		{
+			__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + (i + j * 4) * 4)), mask);
+			__m128i is_opaque = _mm_cmpeq_epi32(a, mask);
+			opaque = _mm_and_si128(opaque, is_opaque);
+			binary = _mm_and_si128(binary, _mm_or_si128(is_opaque, _mm_cmpeq_epi32(a, zero)));
+		}
+		if (_mm_movemask_epi8(binary) != 0xFFFF)
+			return SALVL_ALPHA_BLEND;
+		if (_mm_movemask_epi8(opaque) != 0xFFFF)
+			alpha = SALVL_ALPHA_CUTOUT;
+	}
+#endif
+	for (; i < pixels; i++)
+	{
+		Uint8 a = src[i * 4 + 3];
+		if (a != 0xFF)
+		{
+			if (a != 0x00)
+				return SALVL_ALPHA_BLEND;
+			alpha = SALVL_ALPHA_CUTOUT;
+		}
+	}
+	return alpha;
+}
+
+static void ThresholdAlphaRGBA8(Uint8 *data, size_t pixels)
+{
+	// Keep a cutout texture a cutout after filtering softens its edges
+	for (size_t i = 0; i < pixels; i++)
+		data[i * 4 + 3] = (data[i * 4 + 3] >= 0x80) ? 0xFF : 0x00;
+}
+
+// Texture archives
+#define SALVL_ARCHIVE_FILENAMES  (1 << 3)
+#define SALVL_ARCHIVE_FORMATS    (1 << 2)
+#define SALVL_ARCHIVE_DIMENSIONS (1 << 1)
+#define SALVL_ARCHIVE_GLOBALINDEX (1 << 0)
+
+struct SALVL_ArchiveTexture
+{
+	std::string name;
+	std::vector<Uint8> data; // PVR or GVR texture, starting from its first chunk
+};
+
+static inline Uint16 Archive_Read16(const Uint8 *p, bool be)
+{
+	return be ? (Uint16)((p[0] << 8) | p[1]) : (Uint16)(p[0] | (p[1] << 8));
+}
+
+static inline Uint32 Archive_Read32(const Uint8 *p, bool be)
+{
+	return be ? (((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) | ((Uint32)p[2] << 8) | p[3]) : (p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24));
+}
+
+static bool Archive_IsChunk(const Uint8 *p, const char *magic)
+{
+	return memcmp(p, magic, 4) == 0;
+}
+
+static size_t Archive_ChunkSize(const Uint8 *p, size_t remaining)
+{
+	// Chunk lengths are little endian, but some GameCube tools wrote them big endian
+	size_t size = 8 + (size_t)Archive_Read32(p + 4, false);
+	if (size > remaining && 8 + (size_t)Archive_Read32(p + 4, true) <= remaining)
+		size = 8 + (size_t)Archive_Read32(p + 4, true);
+	return size;
+}
+
+static bool PRS_Decompress(const Uint8 *src, size_t size, std::vector<Uint8> &out)
+{
+	// Sega LZ77, control bits are read LSB first from bytes interleaved with the data
+	size_t pos = 0;
+	Uint32 control = 0;
+	int control_bits = 0;
+	auto bit = [&]() -> int
+	{
+		if (control_bits == 0)
+		{
+			if (pos >= size)
+				return -1;
+			control = src[pos++];
+			control_bits = 8;
+		}
+		int b = control & 1;
+		control >>= 1;
+		control_bits--;
+		return b;
+	};
+
+	out.clear();
+	out.reserve(size * 4);
+	while (1)
+	{
+		int b0 = bit();
+		if (b0 < 0)
+			break;
+		if (b0)
+		{
+			// Literal
+			if (pos >= size)
+				return true;
+			out.push_back(src[pos++]);
+			continue;
+		}
+
+		size_t length, distance;
+		int b1 = bit();
+		if (b1 < 0)
+			return true;
+		if (b1)
+		{
+			// Long copy, 13 bit distance with a 3 bit length or a length byte, zero ends the stream
+			if (pos + 2 > size)
+				return true;
+			Uint32 word = src[pos] | (src[pos + 1] << 8);
+			pos += 2;
+			if (word == 0)
+				break;
+			distance = 0x2000 - (word >> 3);
+			length = word & 7;
+			if (length == 0)
+			{
+				if (pos >= size)
+					return true;
+				length = (size_t)src[pos++] + 1;
+			}
+			else
+			{
+				length += 2;
+			}
+		}
+		else
+		{
+			// Short copy, 2 bit length and 8 bit distance
+			int l1 = bit(), l0 = bit();
+			if (l1 < 0 || l0 < 0 || pos >= size)
+				return true;
+			length = (size_t)((l1 << 1) | l0) + 2;
+			distance = 0x100 - src[pos++];
+		}
+
+		// Copies may overlap their own output
+		if (distance > out.size())
+			return true;
+		size_t from = out.size() - distance;
+		out.resize(out.size() + length);
+		Uint8 *dst = out.data() + from;
+		if (distance >= length)
+			memcpy(dst + distance, dst, length);
+		else
+			for (size_t i = 0; i < length; i++)
+				dst[distance + i] = dst[i];
+	}
+	return out.empty();
+}
+
+static bool Archive_Read(const std::string &path, std::vector<SALVL_ArchiveTexture> &textures)
+{
+	// Read PVM or GVM, possibly PRS compressed
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream.is_open())
+		return true;
+	std::vector<Uint8> file((size_t)stream.tellg());
+	stream.seekg(0);
+	if (!stream.read((char*)file.data(), file.size()) || file.size() < 12)
+		return true;
+
+	if (!Archive_IsChunk(file.data(), "PVMH") && !Archive_IsChunk(file.data(), "GVMH"))
+	{
+		std::vector<Uint8> decompressed;
+		if (PRS_Decompress(file.data(), file.size(), decompressed) || decompressed.size() < 12)
+			return true;
+		file.swap(decompressed);
+		if (!Archive_IsChunk(file.data(), "PVMH") && !Archive_IsChunk(file.data(), "GVMH"))
+			return true;
+	}
+
+	// Header and entry table, GVM entries are big endian
+	bool be = file[0] == 'G';
+	size_t data_offset = 8 + (size_t)Archive_Read32(file.data() + 4, false);
+	Uint16 flags = Archive_Read16(file.data() + 8, be);
+	Uint16 count = Archive_Read16(file.data() + 10, be);
+
+	size_t entry_size = 2;
+	if (flags & SALVL_ARCHIVE_FILENAMES)
+		entry_size += 28;
+	if (flags & SALVL_ARCHIVE_FORMATS)
+		entry_size += 2;
+	if (flags & SALVL_ARCHIVE_DIMENSIONS)
+		entry_size += 2;
+	if (flags & SALVL_ARCHIVE_GLOBALINDEX)
+		entry_size += 4;
+	if (12 + entry_size * count > file.size() || data_offset > file.size())
+		return true;
+
+	// Textures follow each other after the table
+	size_t offset = data_offset;
+	for (Uint16 i = 0; i < count; i++)
+	{
+		SALVL_ArchiveTexture texture;
+		if (flags & SALVL_ARCHIVE_FILENAMES)
+		{
+			const char *name = (const char*)file.data() + 12 + entry_size * i + 2;
+			texture.name = std::string(name, strnlen(name, 28));
+		}
+		else
+		{
+			texture.name = "texture" + std::to_string(i);
+		}
+
+		// Skip padding up to the texture's first chunk
+		auto is_texture = [&](size_t at) { return Archive_IsChunk(file.data() + at, "PVRT") || Archive_IsChunk(file.data() + at, "GVRT"); };
+		auto is_index = [&](size_t at) { return Archive_IsChunk(file.data() + at, "GBIX") || Archive_IsChunk(file.data() + at, "GCIX"); };
+		while (offset + 8 <= file.size() && !is_texture(offset) && !is_index(offset))
+			offset++;
+
+		// Global index chunks are always 16 bytes
+		size_t end = offset;
+		while (end + 8 <= file.size() && is_index(end))
+			end += 16;
+		if (end + 16 > file.size() || !is_texture(end))
+			return true;
+		end += std::min(Archive_ChunkSize(file.data() + end, file.size() - end), file.size() - end);
+
+		texture.data.assign(file.begin() + offset, file.begin() + end);
+		textures.push_back(std::move(texture));
+		offset = end;
+	}
+	return false;
+}
+
+// PVR decoding
+static inline Uint32 PVR_Twiddle(Uint32 x)
+{
+	// Spread the bits of x to the even bits
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+static inline Uint8 Expand5(Uint32 x) { return (Uint8)((x << 3) | (x >> 2)); }
+static inline Uint8 Expand6(Uint32 x) { return (Uint8)((x << 2) | (x >> 4)); }
+
+static bool PVR_Convert(const Uint8 *src, size_t count, Uint8 pixel_format, Uint8 *out)
+{
+	// Convert 16 bit texels to RGBA8, YUV422 texels come in pairs sharing chroma
+	for (size_t i = 0; i < count; i++)
+	{
+		Uint32 c = Archive_Read16(src + i * 2, false);
+		Uint8 *o = out + i * 4;
+		switch (pixel_format)
+		{
+			case 0: // ARGB1555
+				o[0] = Expand5((c >> 10) & 0x1F); o[1] = Expand5((c >> 5) & 0x1F); o[2] = Expand5(c & 0x1F); o[3] = (c & 0x8000) ? 0xFF : 0x00;
+				break;
+			case 1: // RGB565
+				o[0] = Expand5(c >> 11); o[1] = Expand6((c >> 5) & 0x3F); o[2] = Expand5(c & 0x1F); o[3] = 0xFF;
+				break;
+			case 2: // ARGB4444
+				o[0] = (Uint8)(((c >> 8) & 0xF) * 0x11); o[1] = (Uint8)(((c >> 4) & 0xF) * 0x11); o[2] = (Uint8)((c & 0xF) * 0x11); o[3] = (Uint8)((c >> 12) * 0x11);
+				break;
+			case 3: // YUV422
+			{
+				size_t pair = i & ~(size_t)1;
+				if (pair + 1 >= count)
+					return true;
+				int u = src[pair * 2] - 128, v = src[pair * 2 + 2] - 128;
+				int y = c >> 8;
+				o[0] = (Uint8)std::clamp(y + ((v * 352) >> 8), 0, 255);
+				o[1] = (Uint8)std::clamp(y - ((u * 88 + v * 176) >> 8), 0, 255);
+				o[2] = (Uint8)std::clamp(y + ((u * 440) >> 8), 0, 255);
+				o[3] = 0xFF;
+				break;
+			}
+			case 5: // RGB555
+				o[0] = Expand5((c >> 10) & 0x1F); o[1] = Expand5((c >> 5) & 0x1F); o[2] = Expand5(c & 0x1F); o[3] = 0xFF;
+				break;
+			default:
+				return true;
+		}
+	}
+	return false;
+}
+
+static Uint8 *PVR_Decode(const Uint8 *chunk, size_t size, int &w, int &h)
+{
+	// PVRT payload is pixel format, data format, 2 unused bytes, width and height, then texel data
+	if (size < 8)
+		return nullptr;
+	Uint8 pixel_format = chunk[0], data_format = chunk[1];
+	w = Archive_Read16(chunk + 4, false);
+	h = Archive_Read16(chunk + 6, false);
+	const Uint8 *data = chunk + 8;
+	size_t data_size = size - 8;
+	if (w <= 0 || h <= 0 || w > 4096 || h > 4096)
+		return nullptr;
+
+	bool twiddled, vq = false;
+	size_t codebook = 0;
+	size_t level_offset = 0;
+	switch (data_format)
+	{
+		case 0x01: // Square twiddled
+		case 0x0D: // Rectangle twiddled
+			twiddled = true;
+			break;
+		case 0x02: // Square twiddled with mipmaps, smallest first after 6 bytes of padding
+			twiddled = true;
+			level_offset = 6;
+			for (int s = 1; s < w; s <<= 1)
+				level_offset += (size_t)s * s * 2;
+			break;
+		case 0x12: // Square twiddled with mipmaps, 1x1 level padded to 2x1
+			twiddled = true;
+			for (int s = 1; s < w; s <<= 1)
+				level_offset += (size_t)std::max(s * s, 2) * 2;
+			break;
+		case 0x03: // VQ
+		case 0x04: // VQ with mipmaps
+		case 0x10: // Small VQ
+		case 0x11: // Small VQ with mipmaps
+		{
+			twiddled = true;
+			vq = true;
+			bool mipmaps = data_format == 0x04 || data_format == 0x11;
+			codebook = 256;
+			if (data_format == 0x10)
+				codebook = (w <= 16) ? 16 : (w == 32) ? 32 : (w == 64) ? 128 : 256;
+			else if (data_format == 0x11)
+				codebook = (w <= 16) ? 16 : (w == 32) ? 64 : 256;
+			if (mipmaps)
+			{
+				level_offset = 1;
+				for (int s = 2; s < w; s <<= 1)
+					level_offset += (size_t)(s / 2) * (s / 2);
+			}
+			break;
+		}
+		case 0x09: // Rectangle
+		case 0x0B: // Stride
+			twiddled = false;
+			break;
+		default: // Palettized textures need an external palette
+			return nullptr;
+	}
+	if (vq && (w != h || w < 2))
+		return nullptr;
+	if (twiddled && ((w & (w - 1)) != 0 || (h & (h - 1)) != 0))
+		return nullptr;
+
+	// Expand texels, or the codebook for VQ, to RGBA8
+	size_t texels = (size_t)w * h;
+	size_t codebook_size = codebook * 8;
+	size_t level_size = vq ? (texels / 4) : (texels * 2);
+	if (data_size < codebook_size + level_size)
+		return nullptr;
+	if (codebook_size + level_offset + level_size > data_size)
+		level_offset = data_size - codebook_size - level_size; // Trust the chunk end when the padding guess overruns
+	const Uint8 *level = data + codebook_size + level_offset;
+
+	std::vector<Uint8> expanded(vq ? (codebook * 16) : (texels * 4));
+	if (PVR_Convert(vq ? data : level, vq ? (codebook * 4) : texels, pixel_format, expanded.data()))
+		return nullptr;
+
+	Uint8 *pixels = (Uint8*)STBI_MALLOC(texels * 4);
+	if (pixels == nullptr)
+		return nullptr;
+
+	int square = std::min(w, h);
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			const Uint8 *src;
+			if (vq)
+			{
+				// Twiddled codebook indices, each a twiddled 2x2 block
+				Uint8 index = level[(PVR_Twiddle(x >> 1) << 1) | PVR_Twiddle(y >> 1)];
+				if (index >= codebook)
+				{
+					// Small codebooks don't cover every index
+					STBI_FREE(pixels);
+					return nullptr;
+				}
+				src = expanded.data() + ((size_t)index * 4 + (((x & 1) << 1) | (y & 1))) * 4;
+			}
+			else if (twiddled)
+			{
+				// Rectangles are a row or column of twiddled squares
+				size_t block = (size_t)((w > h) ? (x / square) : (y / square)) * square * square;
+				src = expanded.data() + (block + ((PVR_Twiddle(x % square) << 1) | PVR_Twiddle(y % square))) * 4;
+			}
+			else
+			{
+				src = expanded.data() + ((size_t)y * w + x) * 4;
+			}
+			memcpy(pixels + ((size_t)y * w + x) * 4, src, 4);
+		}
+	}
+	return pixels;
+}
+
+// GVR decoding
+static void GVR_Convert(Uint32 c, Uint8 pixel_format, Uint8 *o)
+{
+	// Palette entry to RGBA8
+	switch (pixel_format)
+	{
+		case 0: // IA8
+			o[0] = o[1] = o[2] = (Uint8)(c & 0xFF); o[3] = (Uint8)(c >> 8);
+			break;
+		case 1: // RGB565
+			o[0] = Expand5(c >> 11); o[1] = Expand6((c >> 5) & 0x3F); o[2] = Expand5(c & 0x1F); o[3] = 0xFF;
+			break;
+		default: // RGB5A3
+			if (c & 0x8000)
+			{
+				o[0] = Expand5((c >> 10) & 0x1F); o[1] = Expand5((c >> 5) & 0x1F); o[2] = Expand5(c & 0x1F); o[3] = 0xFF;
+			}
+			else
+			{
+				Uint32 a = (c >> 12) & 7;
+				o[0] = (Uint8)(((c >> 8) & 0xF) * 0x11); o[1] = (Uint8)(((c >> 4) & 0xF) * 0x11); o[2] = (Uint8)((c & 0xF) * 0x11); o[3] = (Uint8)((a << 5) | (a << 2) | (a >> 1));
+			}
+			break;
+	}
+}
+
+static Uint8 *GVR_Decode(const Uint8 *chunk, size_t size, int &w, int &h)
+{
+	// GVRT payload is 2 unused bytes, palette format and flags, data format, width and height, all big endian
+	if (size < 8)
+		return nullptr;
+	Uint8 palette_format = chunk[2] >> 4, flags = chunk[2] & 0xF, data_format = chunk[3];
+	w = Archive_Read16(chunk + 4, true);
+	h = Archive_Read16(chunk + 6, true);
+	const Uint8 *data = chunk + 8;
+	size_t data_size = size - 8;
+	if (w <= 0 || h <= 0 || w > 4096 || h > 4096)
+		return nullptr;
+
+	// Texels are stored in tiles, mipmaps follow the full size level
+	static const struct { int bits, tile_w, tile_h; } layouts[] = {
+		{ 4, 8, 8 }, // I4
+		{ 8, 8, 4 }, // I8
+		{ 8, 8, 4 }, // IA4
+		{ 16, 4, 4 }, // IA8
+		{ 16, 4, 4 }, // RGB565
+		{ 16, 4, 4 }, // RGB5A3
+		{ 32, 4, 4 }, // ARGB8888
+		{ 0, 0, 0 },
+		{ 4, 8, 8 }, // Index4
+		{ 8, 8, 4 }, // Index8
+		{ 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 },
+		{ 4, 8, 8 }, // DXT1
+	};
+	if (data_format >= sizeof(layouts) / sizeof(layouts[0]) || layouts[data_format].bits == 0)
+		return nullptr;
+	int tile_w = layouts[data_format].tile_w, tile_h = layouts[data_format].tile_h;
+
+	// Palettized textures carry their palette before the texels
+	Uint8 palette[256 * 4];
+	if (data_format == 8 || data_format == 9)
+	{
+		if (!(flags & 0x8))
+			return nullptr;
+		size_t entries = (data_format == 8) ? 16 : 256;
+		if (data_size < entries * 2)
+			return nullptr;
+		for (size_t i = 0; i < entries; i++)
+			GVR_Convert(Archive_Read16(data + i * 2, true), palette_format, palette + i * 4);
+		data += entries * 2;
+		data_size -= entries * 2;
+	}
+
+	int tiles_x = (w + tile_w - 1) / tile_w, tiles_y = (h + tile_h - 1) / tile_h;
+	size_t tile_size = (size_t)tile_w * tile_h * layouts[data_format].bits / 8;
+	if (data_size < tile_size * tiles_x * tiles_y)
+		return nullptr;
+
+	Uint8 *pixels = (Uint8*)STBI_MALLOC((size_t)w * h * 4);
+	if (pixels == nullptr)
+		return nullptr;
 
-static bool DoesThisFileExist(const std::string &name)
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			const Uint8 *tile = data + tile_size * ((size_t)ty * tiles_x + tx);
+			Uint8 block[8 * 8 * 4];
+
+			if (data_format == 14)
+			{
+				// Four DXT1 blocks, left to right then top to bottom
+				for (int b = 0; b < 4; b++)
+				{
+					const Uint8 *dxt = tile + b * 8;
+					Uint32 c0 = Archive_Read16(dxt, true), c1 = Archive_Read16(dxt + 2, true);
+					Uint8 colors[4][4];
+					GVR_Convert(c0, 1, colors[0]);
+					GVR_Convert(c1, 1, colors[1]);
+					for (int k = 0; k < 3; k++)
+					{
+						if (c0 > c1)
+						{
+							colors[2][k] = (Uint8)((colors[0][k] * 2 + colors[1][k]) / 3);
+							colors[3][k] = (Uint8)((colors[0][k] + colors[1][k] * 2) / 3);
+						}
+						else
+						{
+							colors[2][k] = (Uint8)((colors[0][k] + colors[1][k]) / 2);
+							colors[3][k] = 0;
+						}
+					}
+					colors[2][3] = 0xFF;
+					colors[3][3] = (c0 > c1) ? 0xFF : 0x00;
+
+					for (int y = 0; y < 4; y++)
+						for (int x = 0; x < 4; x++)
+							memcpy(block + (((b >> 1) * 4 + y) * 8 + (b & 1) * 4 + x) * 4, colors[(dxt[4 + y] >> (6 - x * 2)) & 3], 4);
+				}
+			}
+			else
+			{
+				for (int i = 0; i < tile_w * tile_h; i++)
+				{
+					Uint8 *o = block + i * 4;
+					switch (data_format)
+					{
+						case 0: // I4
+						{
+							Uint8 v = (Uint8)(((tile[i >> 1] >> ((i & 1) ? 0 : 4)) & 0xF) * 0x11);
+							o[0] = o[1] = o[2] = o[3] = v;
+							break;
+						}
+						case 1: // I8
+							o[0] = o[1] = o[2] = o[3] = tile[i];
+							break;
+						case 2: // IA4
+							o[0] = o[1] = o[2] = (Uint8)((tile[i] & 0xF) * 0x11);
+							o[3] = (Uint8)((tile[i] >> 4) * 0x11);
+							break;
+						case 3: // IA8
+							GVR_Convert(Archive_Read16(tile + i * 2, true), 0, o);
+							break;
+						case 4: // RGB565
+							GVR_Convert(Archive_Read16(tile + i * 2, true), 1, o);
+							break;
+						case 5: // RGB5A3
+							GVR_Convert(Archive_Read16(tile + i * 2, true), 2, o);
+							break;
+						case 6: // ARGB8888, alpha and red then green and blue halves
+							o[3] = tile[i * 2]; o[0] = tile[i * 2 + 1];
+							o[1] = tile[32 + i * 2]; o[2] = tile[32 + i * 2 + 1];
+							break;
+						case 8: // Index4
+							memcpy(o, palette + ((tile[i >> 1] >> ((i & 1) ? 0 : 4)) & 0xF) * 4, 4);
+							break;
+						case 9: // Index8
+							memcpy(o, palette + tile[i] * 4, 4);
+							break;
+					}
+				}
+			}
+
+			// Place the tile, clipping to the texture
+			for (int y = 0; y < tile_h; y++)
+			{
+				int py = ty * tile_h + y;
+				if (py >= h)
+					break;
+				int px = tx * tile_w, n = std::min(tile_w, w - px);
+				memcpy(pixels + ((size_t)py * w + px) * 4, block + (size_t)y * tile_w * 4, (size_t)n * 4);
+			}
+		}
+	}
+	return pixels;
+}
+
+static Uint8 *Archive_Decode(const Uint8 *data, size_t data_size, int &w, int &h)
 {
-	std::ifstream f(name.c_str());
-	return f.good();
+	// Decode an archive texture to RGBA8, the result is freed with STBI_FREE
+	size_t offset = 0;
+	while (offset + 16 <= data_size && (Archive_IsChunk(data + offset, "GBIX") || Archive_IsChunk(data + offset, "GCIX")))
+		offset += 16;
+	if (offset + 8 > data_size)
+		return nullptr;
+	const Uint8 *chunk = data + offset;
+	size_t size = std::min(Archive_ChunkSize(chunk, data_size - offset), data_size - offset) - 8;
+
+	if (Archive_IsChunk(chunk, "PVRT"))
+		return PVR_Decode(chunk + 8, size, w, h);
+	if (Archive_IsChunk(chunk, "GVRT"))
+		return GVR_Decode(chunk + 8, size, w, h);
+	return nullptr;
 }
 
-// Roblox enums
-std::unordered_map<std::string, int> rbxenum_material = {
-	{ "Plastic", 256 },
-	{ "SmoothPlastic", 272 },
-	{ "Neon", 288 },
-	{ "Wood", 512 },
-	{ "WoodPlanks", 528 },
-	{ "Marble", 784 },
-	{ "Basalt", 788 },
-	{ "Slate", 800 },
-	{ "CrackedLava", 804 },
-	{ "Concrete", 816 },
-	{ "Limestone", 820 },
-	{ "Granite", 832 },
-	{ "Pavement", 836 },
-	{ "Brick", 848 },
-	{ "Pebble", 864 },
-	{ "Cobblestone", 880 },
-	{ "Rock", 896 },
-	{ "Sandstone", 912 },
-	{ "CorrodedMetal", 1040 },
-	{ "DiamondPlate", 1056 },
-	{ "Foil", 1072 },
-	{ "Metal", 1088 },
-	{ "Grass", 1280 },
-	{ "LeafyGrass", 1284 },
-	{ "Sand", 1296 },
-	{ "Fabric", 1312 },
-	{ "Snow", 1328 },
-	{ "Mud", 1344 },
-	{ "Ground", 1360 },
-	{ "Asphalt", 1376 },
-	{ "Salt", 1392 },
-	{ "Ice", 1536 },
-	{ "Glacier", 1552 },
-	{ "Glass", 1568 },
-	{ "ForceField", 1584 },
-	{ "Air", 1792 },
-	{ "Water", 2048 },
-	{ "Cardboard", 2304 },
-	{ "Carpet", 2305 },
-	{ "CeramicTiles", 2306 },
-	{ "ClayRoofTiles", 2307 },
-	{ "RoofShingles", 2308 },
-	{ "Leather", 2309 },
-	{ "Plaster", 2310 },
-	{ "Rubber", 2311 },
-};
+// Texture cache
+#define SALVL_TEXCACHE_MAGIC "SALVLTEXCACHE 5"
 
-// CSG mesh
-#include "md5.h"
+#define SALVL_TEXVARIANT_BASE (1 << 0)
+#define SALVL_TEXVARIANT_FU   (1 << 1)
+#define SALVL_TEXVARIANT_FV   (1 << 2)
+#define SALVL_TEXVARIANT_FUV  (1 << 3)
+#define SALVL_TEXVARIANT_ALL  (SALVL_TEXVARIANT_BASE | SALVL_TEXVARIANT_FU | SALVL_TEXVARIANT_FV | SALVL_TEXVARIANT_FUV)
 
-struct SALVL_CSGMesh
+struct SALVL_TextureCacheEntry
 {
-	// Encoded data
-	std::string enc_base64; // Base64 encoded
-	std::string enc_hash; // MD5 hash
+	std::uint64_t hash = 0; // Source file content hash
+	std::uint64_t pixels = 0; // Decoded pixel hash
+	int xres = 0, yres = 0; // Source resolution
+	int max_res = 0; // Resolution budget the variants were generated with
+	std::uint64_t mutation = 0; // Mutation seed the variants were generated with, 0 if random
+	Uint8 alpha = SALVL_ALPHA_OPAQUE;
+	std::string path, path_fu, path_fv, path_fuv; // Generated variants, empty if not generated
+};
 
-	std::string Base64(const Uint8 *data, size_t size)
+static std::uint64_t TextureCache_Hash(const Uint8 *data, size_t size)
+{
+	// FNV-1a over 8 byte words, with a final avalanche
+	std::uint64_t h = 0xCBF29CE484222325ULL ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
 	{
-		// Get basic output
-		static const char *lookup = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::uint64_t w;
+		memcpy(&w, data + i, 8);
+		h ^= w;
+		h *= 0x100000001B3ULL;
+		h ^= h >> 32;
+	}
+	for (; i < size; i++)
+	{
+		h ^= data[i];
+		h *= 0x100000001B3ULL;
+	}
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 32;
+	return h;
+}
 
-		std::string out;
-		out.reserve(size);
+static void TextureCache_Read(const std::string &path, std::unordered_map<std::string, SALVL_TextureCacheEntry> &cache)
+{
+	// A missing or outdated manifest just means everything is regenerated
+	std::ifstream stream(path);
+	if (!stream.is_open())
+		return;
 
-		int val = 0;
-		int valb = -6;
+	std::string line;
+	if (!std::getline(stream, line) || line != SALVL_TEXCACHE_MAGIC)
+		return;
 
-		for (size_t i = 0; i < size; i++)
+	while (std::getline(stream, line))
+	{
+		// name hash pixels xres yres max_res alpha mutation path path_fu path_fv path_fuv, tab separated
+		std::string field[12];
+		size_t fields = 0, start = 0;
+		for (; fields < 12; fields++)
 		{
-			val = (val << 8) + data[i];
-			valb += 8;
-			while (valb >= 0)
+			size_t end = line.find('\t', start);
+			field[fields] = line.substr(start, end - start);
+			if (end == std::string::npos)
 			{
-				out.push_back(lookup[(val >> valb) & 0x3F]);
-				valb -= 6;
+				fields++;
+				break;
 			}
+			start = end + 1;
 		}
+		if (fields != 12)
+			continue;
 
-		if (valb > -6)
-			out.push_back(lookup[((val << 8) >> (valb + 8)) & 0x3F]);
-
-		while (out.size() % 4)
-			out.push_back('=');
-
-		// Line break
-		std::string result;
-		for (size_t i = 0; i < out.size(); i += 72)
+		SALVL_TextureCacheEntry entry;
+		try
 		{
-			if (i != 0)
-				result.push_back('\n');
-			result += out.substr(i, 72);
+			entry.hash = std::stoull(field[1], nullptr, 16);
+			entry.pixels = std::stoull(field[2], nullptr, 16);
+			entry.xres = std::stoi(field[3]);
+			entry.yres = std::stoi(field[4]);
+			entry.max_res = std::stoi(field[5]);
+			entry.alpha = (Uint8)std::stoi(field[6]);
+			if (entry.alpha > SALVL_ALPHA_BLEND)
+				continue;
+			entry.mutation = std::stoull(field[7], nullptr, 16);
 		}
-
-		return result;
+		catch (...)
+		{ continue; }
+		entry.path = field[8];
+		entry.path_fu = field[9];
+		entry.path_fv = field[10];
+		entry.path_fuv = field[11];
+		cache[field[0]] = entry;
 	}
+}
 
-	void Encode(std::vector<Uint8> &data)
+static bool TextureCache_Write(const std::string &path, const std::unordered_map<std::string, SALVL_TextureCacheEntry> &cache)
+{
+	// Sort entries so the manifest is stable between runs
+	std::vector<const std::pair<const std::string, SALVL_TextureCacheEntry>*> entries;
+	for (auto &i : cache)
+		entries.push_back(&i);
+	std::sort(entries.begin(), entries.end(), [](auto a, auto b) { return a->first < b->first; });
+
+	std::ofstream stream(path);
+	if (!stream.is_open())
+		return true;
+
+	stream << SALVL_TEXCACHE_MAGIC << "\n";
+	for (auto &i : entries)
 	{
-		// Encode to Base64 (UGH)
-		enc_base64 = Base64(data.data(), data.size());
+		const SALVL_TextureCacheEntry &entry = i->second;
+		stream << i->first << "\t" << std::hex << entry.hash << "\t" << entry.pixels << std::dec << "\t" << entry.xres << "\t" << entry.yres << "\t" << entry.max_res << "\t" << (int)entry.alpha << "\t" << std::hex << entry.mutation << std::dec << "\t"
+			<< entry.path << "\t" << entry.path_fu << "\t" << entry.path_fv << "\t" << entry.path_fuv << "\n";
+	}
+	return !stream.good();
+}
 
-		// Encode to MD5 then to Base64
-		MD5 md5;
-		md5.Init();
-		md5.Update((unsigned char*)enc_base64.c_str(), enc_base64.size());
-		md5.Final();
+// Texture mutation
+struct SALVL_Random
+{
+	// SplitMix64, local so results don't depend on the order workers run in
+	std::uint64_t state;
+
+	SALVL_Random(std::uint64_t seed) : state(seed) {}
 
-		enc_hash = Base64(md5.digestRaw, 16);
+	Uint32 Next()
+	{
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return (Uint32)((z ^ (z >> 31)) >> 32);
 	}
 };
 
-// Ninja reimplementation
-void Reimp_njRotateX(NJS_MATRIX cframe, Angle x)
+static std::uint64_t Texture_MutationSeed(std::uint64_t seed, std::string_view name)
 {
-	// Calculate the sine and cosine of our angle
-	Float sin = sinf((float)x * 3.14159265358979323846f / 0x8000);
-	Float cos = cosf((float)x * 3.14159265358979323846f / 0x8000);
-
-	// Apply rotation onto matrix
-	Float m10 = cframe[M10];
-	Float m11 = cframe[M11];
-	Float m12 = cframe[M12];
-	Float m13 = cframe[M13];
+	// Same seed and texture name always give the same mutation
+	return seed ^ TextureCache_Hash((const Uint8*)name.data(), name.size());
+}
 
-	cframe[M10] = sin * cframe[M20] + m10 * cos;
-	cframe[M11] = sin * cframe[M21] + m11 * cos;
-	cframe[M12] = sin * cframe[M22] + m12 * cos;
-	cframe[M13] = sin * cframe[M23] + m13 * cos;
-	cframe[M20] = cos * cframe[M20] - m10 * sin;
-	cframe[M21] = cos * cframe[M21] - m11 * sin;
-	cframe[M22] = cos * cframe[M22] - m12 * sin;
-	cframe[M23] = cos * cframe[M23] - m13 * sin;
+// Texture atlas
+static int Atlas_Variant(Uint32 matflags)
+{
+	// Texture variant index used by a material
+	if (matflags & NJD_FLAG_FLIP_U)
+		return (matflags & NJD_FLAG_FLIP_V) ? 3 : 1;
+	return (matflags & NJD_FLAG_FLIP_V) ? 2 : 0;
 }
 
-void Reimp_njRotateY(NJS_MATRIX cframe, Angle x)
+static bool Atlas_Build(SALVL &lvl, const std::string &path_content, int page_size, int png_effort, unsigned int jobs, std::vector<SALVL_ScratchPool> &scratch)
 {
-	// Calculate the sine and cosine of our angle
-	Float sin = sinf((float)x * 3.14159265358979323846f / 0x8000);
-	Float cos = cosf((float)x * 3.14159265358979323846f / 0x8000);
+	// Pack texture variants that are never tiled into shared pages, keyed by texture index * 4 + variant
+	static const int padding = 2;
 
-	// Apply rotation onto matrix
-	Float m00 = cframe[M00];
-	Float m01 = cframe[M01];
-	Float m02 = cframe[M02];
-	Float m03 = cframe[M03];
+	// Find which variants only ever have UVs within the texture
+	std::unordered_map<size_t, bool> eligible;
+	std::vector<SALVL_MeshPart*> textured_parts;
+	for (auto &mesh : lvl.meshes)
+	{
+		for (auto &part : mesh.second.parts)
+		{
+			SALVL_MeshPart &meshpart = part.second;
+			if (!(meshpart.matflags & NJD_FLAG_USE_TEXTURE) || meshpart.texture == nullptr)
+				continue;
+			textured_parts.push_back(&meshpart);
 
-	cframe[M00] = m00 * cos - sin * cframe[M20];
-	cframe[M01] = m01 * cos - sin * cframe[M21];
-	cframe[M02] = m02 * cos - sin * cframe[M22];
-	cframe[M03] = m03 * cos - sin * cframe[M23];
-	cframe[M20] = cos * cframe[M20] + m00 * sin;
-	cframe[M21] = cos * cframe[M21] + m01 * sin;
-	cframe[M22] = cos * cframe[M22] + m02 * sin;
-	cframe[M23] = cos * cframe[M23] + m03 * sin;
-}
+			size_t key = (size_t)(meshpart.texture - lvl.textures.data()) * 4 + Atlas_Variant(meshpart.matflags);
+			bool in_range = true;
+			for (auto &v : meshpart.vertex)
+			{
+				if (!(v.tex.x >= -0.0001f && v.tex.x <= 1.0001f && v.tex.y >= -0.0001f && v.tex.y <= 1.0001f))
+				{
+					in_range = false;
+					break;
+				}
+			}
 
-void Reimp_njRotateZ(NJS_MATRIX cframe, Angle x)
-{
-	// Calculate the sine and cosine of our angle
-	Float sin = sinf((float)x * 3.14159265358979323846f / 0x8000);
-	Float cos = cosf((float)x * 3.14159265358979323846f / 0x8000);
+			auto it = eligible.emplace(key, in_range);
+			if (!in_range)
+				it.first->second = false;
+		}
+	}
 
-	// Apply rotation onto matrix
-	Float m00 = cframe[M00];
-	Float m01 = cframe[M01];
-	Float m02 = cframe[M02];
-	Float m03 = cframe[M03];
+	// Group eligible variants by what the atlas texture itself carries
+	struct Rect
+	{
+		size_t key;
+		int w, h;
+		int x = 0, y = 0, page = -1;
+		bool dropped = false;
+	};
+	std::map<std::pair<const SALVL_Material*, Uint8>, std::vector<Rect>> groups;
+	for (auto &i : eligible)
+	{
+		if (!i.second)
+			continue;
+		const SALVL_Texture &texture = lvl.textures[i.first / 4];
+		int variant = (int)(i.first % 4);
+		Rect rect;
+		rect.key = i.first;
+		rect.w = texture.xres_variant[variant];
+		rect.h = texture.yres_variant[variant];
+		if (rect.w <= 0 || rect.h <= 0 || rect.w > page_size / 2 || rect.h > page_size / 2)
+			continue;
+		groups[{ texture.material, texture.alpha }].push_back(rect);
+	}
 
-	cframe[M00] = m00 * cos + sin * cframe[M10];
-	cframe[M01] = m01 * cos + sin * cframe[M11];
-	cframe[M02] = m02 * cos + sin * cframe[M12];
-	cframe[M03] = m03 * cos + sin * cframe[M13];
-	cframe[M10] = cos * cframe[M10] - m00 * sin;
-	cframe[M11] = cos * cframe[M11] - m01 * sin;
-	cframe[M12] = cos * cframe[M12] - m02 * sin;
-	cframe[M13] = cos * cframe[M13] - m03 * sin;
-}
+	// Shelf pack each group, tallest first
+	struct Page
+	{
+		const SALVL_Material *material;
+		Uint8 alpha;
+		int w = 0, h = 0;
+		std::vector<Rect*> rects;
+	};
+	std::vector<Page> pages;
+	for (auto &group : groups)
+	{
+		std::vector<Rect> &rects = group.second;
+		std::sort(rects.begin(), rects.end(), [](const Rect &a, const Rect &b) { return a.h != b.h ? a.h > b.h : a.key < b.key; });
 
-// File writes
-void Write16(std::ofstream &stream, Uint16 x)
-{
-	stream.put((char)x);
-	stream.put((char)(x >> 8));
-}
-void Write32(std::ofstream &stream, Uint32 x)
-{
-	stream.put((char)x);
-	stream.put((char)(x >> 8));
-	stream.put((char)(x >> 16));
-	stream.put((char)(x >> 24));
-}
-void WriteFloat(std::ofstream &stream, float x)
-{
-	Write32(stream, *(Uint32*)&x);
-}
+		size_t first_page = pages.size();
+		int shelf_x = 0, shelf_y = 0, shelf_h = 0;
+		for (auto &rect : rects)
+		{
+			int w = rect.w + padding * 2, h = rect.h + padding * 2;
+			if (pages.size() == first_page || shelf_x + w > page_size)
+			{
+				// Start a new shelf, or a new page if it doesn't fit
+				shelf_y += shelf_h;
+				shelf_x = 0;
+				shelf_h = 0;
+				if (pages.size() == first_page || shelf_y + h > page_size)
+				{
+					Page page;
+					page.material = group.first.first;
+					page.alpha = group.first.second;
+					pages.push_back(page);
+					shelf_y = 0;
+				}
+			}
 
-template<typename T> void Push16(std::vector<T> &stream, Uint16 x)
-{
-	stream.push_back((T)x);
-	stream.push_back((T)(x >> 8));
-}
-template<typename T> void Push32(std::vector<T> &stream, Uint32 x)
-{
-	stream.push_back((T)x);
-	stream.push_back((T)(x >> 8));
-	stream.push_back((T)(x >> 16));
-	stream.push_back((T)(x >> 24));
-}
-template<typename T> void PushFloat(std::vector<T> &stream, float x)
-{
-	Push32<T>(stream, *(Uint32*)&x);
+			Page &page = pages.back();
+			rect.page = (int)(pages.size() - 1);
+			rect.x = shelf_x + padding;
+			rect.y = shelf_y + padding;
+			page.rects.push_back(&rect);
+			page.w = std::max(page.w, shelf_x + w);
+			page.h = std::max(page.h, shelf_y + h);
+
+			shelf_x += w;
+			shelf_h = std::max(shelf_h, h);
+		}
+	}
+
+	// A page holding a single texture saves nothing
+	std::unordered_map<size_t, const Rect*> placed;
+	std::vector<Page> kept_pages;
+	for (auto &page : pages)
+	{
+		if (page.rects.size() < 2)
+			continue;
+		for (auto &rect : page.rects)
+		{
+			rect->page = (int)kept_pages.size();
+			placed[rect->key] = rect;
+		}
+		kept_pages.push_back(std::move(page));
+	}
+	if (kept_pages.empty())
+		return false;
+
+	lvl.atlases.resize(kept_pages.size());
+	for (size_t i = 0; i < kept_pages.size(); i++)
+	{
+		SALVL_Texture &atlas = lvl.atlases[i];
+		atlas.name = lvl.strings.Intern({ "atlas", std::to_string(i), ".png" });
+		atlas.name_fu = atlas.name_fv = atlas.name_fuv = atlas.name;
+		atlas.path = lvl.strings.Intern({ path_content, "salvl/", atlas.name });
+		atlas.path_fu = atlas.path_fv = atlas.path_fuv = atlas.path;
+		atlas.material = kept_pages[i].material;
+		atlas.alpha = kept_pages[i].alpha;
+		atlas.xres = kept_pages[i].w;
+		atlas.yres = kept_pages[i].h;
+		std::fill(atlas.xres_variant, atlas.xres_variant + 4, atlas.xres);
+		std::fill(atlas.yres_variant, atlas.yres_variant + 4, atlas.yres);
+	}
+
+	// Compose and write pages, with no more workers than there are scratch pools
+	std::vector<Uint8> page_failed(kept_pages.size(), 0);
+	SALVL_ParallelFor((unsigned int)std::min<size_t>(jobs, scratch.size()), kept_pages.size(), [&](size_t pi, unsigned int worker)
+	{
+		const Page &page = kept_pages[pi];
+		size_t page_bytes = (size_t)page.w * page.h * 4;
+		Uint8 *pixels = scratch[worker].Get(SALVL_SCRATCH_ATLAS, page_bytes);
+		if (pixels == nullptr)
+		{
+			page_failed[pi] = 1;
+			return;
+		}
+		memset(pixels, 0, page_bytes);
+
+		size_t copied = 0;
+		for (auto &rect : page.rects)
+		{
+			const SALVL_Texture &texture = lvl.textures[rect->key / 4];
+			const std::string_view *variant_path[4] = { &texture.path, &texture.path_fu, &texture.path_fv, &texture.path_fuv };
+
+			int w, h;
+			unsigned char *src = stbi_load(std::string(*variant_path[rect->key % 4]).c_str(), &w, &h, NULL, 4);
+			if (src == nullptr || w != rect->w || h != rect->h)
+			{
+				// Leave it out of the page, parts using it keep the standalone texture
+				stbi_image_free(src);
+				rect->dropped = true;
+				continue;
+			}
+
+			// Copy with edges extended into the padding so filtering doesn't bleed between textures
+			for (int y = -padding; y < h + padding; y++)
+			{
+				int sy = std::min(std::max(y, 0), h - 1);
+				Uint8 *dst = pixels + ((size_t)(rect->y + y) * page.w + rect->x) * 4;
+				const Uint8 *row = src + (size_t)sy * w * 4;
+				for (int x = -padding; x < 0; x++)
+					memcpy(dst + x * 4, row, 4);
+				memcpy(dst, row, (size_t)w * 4);
+				for (int x = w; x < w + padding; x++)
+					memcpy(dst + x * 4, row + (w - 1) * 4, 4);
+			}
+			stbi_image_free(src);
+			copied++;
+		}
+
+		// Nothing will point at a page that lost every texture
+		if (copied == 0)
+			return;
+		if (PNG_Write(std::string(lvl.atlases[pi].path), pixels, page.w, page.h, png_effort, 1, scratch[worker]))
+			page_failed[pi] = 1;
+	});
+	for (auto &i : page_failed)
+		if (i)
+			return true;
+
+	for (auto &page : kept_pages)
+	{
+		for (auto &rect : page.rects)
+		{
+			if (!rect->dropped)
+				continue;
+			const SALVL_Texture &texture = lvl.textures[rect->key / 4];
+			const std::string_view *variant_name[4] = { &texture.name, &texture.name_fu, &texture.name_fv, &texture.name_fuv };
+			std::cout << "  " << *variant_name[rect->key % 4] << " failed to load or changed size, left out of its atlas" << std::endl;
+		}
+	}
+
+	// Point parts at their atlas and remap UVs into its rectangle
+	for (auto &meshpart : textured_parts)
+	{
+		auto it = placed.find((size_t)(meshpart->texture - lvl.textures.data()) * 4 + Atlas_Variant(meshpart->matflags));
+		if (it == placed.end() || it->second->dropped)
+			continue;
+		const Rect &rect = *it->second;
+		const SALVL_Texture &atlas = lvl.atlases[rect.page];
+
+		float su = (float)rect.w / atlas.xres, ou = (float)rect.x / atlas.xres;
+		float sv = (float)rect.h / atlas.yres, ov = (float)rect.y / atlas.yres;
+		for (auto &v : meshpart->vertex)
+		{
+			v.tex.x = ou + std::min(std::max(v.tex.x, 0.0f), 1.0f) * su;
+			v.tex.y = ov + std::min(std::max(v.tex.y, 0.0f), 1.0f) * sv;
+		}
+
+		meshpart->ClearVertexIndex();
+		meshpart->texture = &lvl.atlases[rect.page];
+		meshpart->matflags &= ~(NJD_FLAG_FLIP_U | NJD_FLAG_FLIP_V | NJD_FLAG_CLAMP_U | NJD_FLAG_CLAMP_V);
+	}
+
+	// Merge parts of a mesh that now share the same material
+	for (auto &mesh : lvl.meshes)
+	{
+		std::vector<int> keys;
+		for (auto &i : mesh.second.parts)
+			keys.push_back(i.first);
+		std::sort(keys.begin(), keys.end());
+
+		std::map<std::tuple<SALVL_Texture*, Uint32, Uint32>, int> targets;
+		for (int key : keys)
+		{
+			SALVL_MeshPart &meshpart = mesh.second.parts[key];
+			if (meshpart.texture == nullptr || meshpart.texture < lvl.atlases.data() || meshpart.texture >= lvl.atlases.data() + lvl.atlases.size())
+				continue;
+
+			auto target = targets.emplace(std::make_tuple(meshpart.texture, meshpart.matflags, meshpart.diffuse), key);
+			if (target.second)
+				continue;
+
+			SALVL_MeshPart &into = mesh.second.parts[target.first->second];
+			SALVL_Index base = (SALVL_Index)into.vertex.size();
+			into.vertex.insert(into.vertex.end(), meshpart.vertex.begin(), meshpart.vertex.end());
+			for (auto &face : meshpart.indices)
+				into.indices.push_back(SALVL_MeshFace(face.i[0] + base, face.i[1] + base, face.i[2] + base));
+			mesh.second.parts.erase(key);
+		}
+	}
+
+	return false;
 }
 
 // Asset upload
@@ -326,7 +3586,7 @@ public:
 		return false;
 	}
 
-	std::string UploadAsset(std::string object, std::vector<char> data)
+	std::string UploadAsset(const std::string &object, const std::vector<char> &data)
 	{
 		// Open request to upload service
 		static PCSTR accept_types[] = { "*/*", nullptr };
@@ -445,12 +3705,22 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 {
 	SALVL lvl;
 
-	// Randomize mutation
-	srand((int)time(nullptr));
-
 	// Check arguments
 	std::string targv[5];
-	if (argc < 5)
+	std::unordered_map<std::string, std::string> options;
+
+	int targc = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		// Options are given as --name value
+		std::string arg(argv[i]);
+		if (arg.size() > 2 && arg.compare(0, 2, "--") == 0 && (i + 1) < argc)
+			options[arg.substr(2)] = std::string(argv[++i]);
+		else if (targc < 5)
+			targv[targc++] = arg;
+	}
+
+	if (targc < 5)
 	{
 		std::cout << "Please input: upload/[content directory] scale salvl texlist_index_txt" << std::endl;
 		std::cin >> std::quoted(targv[1]);
@@ -458,13 +3728,6 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 		std::cin >> std::quoted(targv[3]);
 		std::cin >> std::quoted(targv[4]);
 	}
-	else
-	{
-		targv[1] = std::string(argv[1]);
-		targv[2] = std::string(argv[2]);
-		targv[3] = std::string(argv[3]);
-		targv[4] = std::string(argv[4]);
-	}
 
 	// Get content folder
 	std::string path_content = targv[1];
@@ -534,24 +3797,109 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 			return 1;
 		}
 	}
-	else
+	else
+	{
+		// Ensure content path has slash at the end
+		if (path_content.back() != '/' && path_content.back() != '\\')
+			path_content += "/";
+	}
+	CreateDirectoryA((path_content + "salvl").c_str(), NULL);
+
+	// Get other arguments
+	bool output_rbxm = false;
+	if (options.count("format"))
+	{
+		if (options["format"] == "rbxm")
+			output_rbxm = true;
+		else if (options["format"] != "rbxmx")
+		{ std::cout << "Invalid format parameter" << std::endl; system("pause"); return 1; }
+	}
+	std::string path_model = path_content + (output_rbxm ? "salvl/level.rbxm" : "salvl/level.rbxmx");
+
+	float scale;
+	try
+	{ scale = std::stof(targv[2]); }
+	catch (...)
+	{ std::cout << "Invalid scale parameter" << std::endl; system("pause"); return 1; }
+
+	std::string path_lvl = targv[3];
+
+	unsigned int jobs = std::thread::hardware_concurrency();
+	if (jobs == 0)
+		jobs = 1;
+	unsigned int max_jobs = jobs * 4;
+	if (options.count("jobs"))
+	{
+		// stoul would wrap negative values around
+		if (options["jobs"].find('-') != std::string::npos)
+		{ std::cout << "Invalid jobs parameter" << std::endl; system("pause"); return 1; }
+		try
+		{ jobs = (unsigned int)std::min<unsigned long>(std::stoul(options["jobs"]), max_jobs); }
+		catch (...)
+		{ std::cout << "Invalid jobs parameter" << std::endl; system("pause"); return 1; }
+		if (jobs == 0)
+			jobs = 1;
+	}
+
+	int png_effort = 4;
+	if (options.count("compression"))
+	{
+		try
+		{ png_effort = std::stoi(options["compression"]); }
+		catch (...)
+		{ std::cout << "Invalid compression parameter" << std::endl; system("pause"); return 1; }
+		if (png_effort < 0 || png_effort > 9)
+		{ std::cout << "Invalid compression parameter" << std::endl; system("pause"); return 1; }
+	}
+
+	int max_res = 1024;
+	if (options.count("maxres"))
+	{
+		try
+		{ max_res = std::stoi(options["maxres"]); }
+		catch (...)
+		{ std::cout << "Invalid maxres parameter" << std::endl; system("pause"); return 1; }
+		if (max_res < 0 || max_res == 1)
+		{ std::cout << "Invalid maxres parameter" << std::endl; system("pause"); return 1; }
+	}
+
+	int atlas_size = 0;
+	if (options.count("atlas"))
 	{
-		// Ensure content path has slash at the end
-		if (path_content.back() != '/' && path_content.back() != '\\')
-			path_content += "/";
+		try
+		{ atlas_size = std::stoi(options["atlas"]); }
+		catch (...)
+		{ std::cout << "Invalid atlas parameter" << std::endl; system("pause"); return 1; }
+		if (atlas_size < 0 || atlas_size > 4096)
+		{ std::cout << "Invalid atlas parameter" << std::endl; system("pause"); return 1; }
 	}
-	CreateDirectoryA((path_content + "salvl").c_str(), NULL);
 
-	// Get other arguments
-	std::string path_rbxmx = path_content + "salvl/level.rbxmx";
+	bool variants_all = false;
+	if (options.count("variants"))
+	{
+		if (options["variants"] == "all")
+			variants_all = true;
+		else if (options["variants"] != "used")
+		{ std::cout << "Invalid variants parameter" << std::endl; system("pause"); return 1; }
+	}
 
-	float scale;
-	try
-	{ scale = std::stof(targv[2]); }
-	catch (...)
-	{ std::cout << "Invalid scale parameter" << std::endl; return 1; }
+	// Mutation is keyed on the salt and texture name when salted, otherwise it differs every run
+	bool mutation_salted = options.count("salt") != 0;
+	std::uint64_t mutation_seed = (std::uint64_t)time(nullptr);
+	if (mutation_salted)
+		mutation_seed = TextureCache_Hash((const Uint8*)options["salt"].data(), options["salt"].size());
 
-	std::string path_lvl = targv[3];
+	size_t split_vertices = 65535;
+	if (options.count("split"))
+	{
+		// stoul would wrap negative values around
+		if (options["split"].find('-') != std::string::npos)
+		{ std::cout << "Invalid split parameter" << std::endl; system("pause"); return 1; }
+		try
+		{ split_vertices = std::stoul(options["split"]); }
+		catch (...)
+		{ std::cout << "Invalid split parameter" << std::endl; system("pause"); return 1; }
+	}
 
 	std::string path_texlist = targv[4];
 	std::string path_texbase;
@@ -560,252 +3908,651 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 	if (path_base_cut != std::string::npos)
 		path_texbase = path_texlist.substr(0, path_base_cut + 1);
 
-	// Read texlist
+	// Read texlist, either an exported texture pack index or the PVM/GVM archive itself
 	std::cout << "Reading texlist..." << std::endl;
 
-	std::ifstream stream_texlist(path_texlist);
-	if (!stream_texlist.is_open())
+	auto push_texture = [&](SALVL_Texture &texture, std::string_view name)
 	{
-		std::cout << "Failed to open texlist index " << path_texlist << std::endl;
-		system("pause");
-		return 1;
-	}
+		texture.name = lvl.strings.Intern({ name });
+		texture.name_fu = lvl.strings.Intern({ "u_", name });
+		texture.name_fv = lvl.strings.Intern({ "v_", name });
+		texture.name_fuv = lvl.strings.Intern({ "uv_", name });
+
+		texture.path = lvl.strings.Intern({ path_content, "salvl/", texture.name });
+		texture.path_fu = lvl.strings.Intern({ path_content, "salvl/", texture.name_fu });
+		texture.path_fv = lvl.strings.Intern({ path_content, "salvl/", texture.name_fv });
+		texture.path_fuv = lvl.strings.Intern({ path_content, "salvl/", texture.name_fuv });
+
+		// Push to texture list
+		lvl.textures.push_back(texture);
+	};
+
+	std::string texlist_ext = path_texlist.substr(std::min(path_texlist.find_last_of('.'), path_texlist.size()));
+	for (auto &i : texlist_ext)
+		i = (char)tolower(i);
+	bool texlist_archive = texlist_ext == ".pvm" || texlist_ext == ".gvm" || texlist_ext == ".prs";
+	std::vector<SALVL_ArchiveTexture> tex_archive;
+
+	if (texlist_archive)
+	{
+		// Textures are decoded straight from the archive
+		if (Archive_Read(path_texlist, tex_archive))
+		{
+			std::cout << "Failed to read texture archive " << path_texlist << std::endl;
+			system("pause");
+			return 1;
+		}
 
-	while (!stream_texlist.eof())
+		for (auto &i : tex_archive)
+		{
+			SALVL_Texture texture;
+			push_texture(texture, i.name + ".png");
+		}
+	}
+	else
 	{
-		// Read line
-		std::string line;
-		std::getline(stream_texlist, line);
+		// Map the index and slice it in place, only the texture names are copied out
+		SALVL_MappedFile map_texlist;
+		if (map_texlist.Open(path_texlist))
+		{
+			std::cout << "Failed to open texlist index " << path_texlist << std::endl;
+			system("pause");
+			return 1;
+		}
 
-		// Read texture name
-		SALVL_Texture texture;
+		std::string_view texlist(map_texlist.data, map_texlist.size);
+		while (!texlist.empty())
+		{
+			// Read line
+			size_t delim_line = texlist.find('\n');
+			std::string_view line = texlist.substr(0, delim_line);
+			texlist.remove_prefix((delim_line != std::string_view::npos) ? (delim_line + 1) : texlist.size());
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
 
-		auto delim_pathstart = line.find_first_of(",");
-		auto delim_pathend = line.find_last_of(",");
+			// Read texture name
+			SALVL_Texture texture;
 
-		if (delim_pathstart != std::string::npos && delim_pathend != std::string::npos)
-		{
-			// Get texture material
-			auto delim_material = line.find_last_of(":");
-			if (delim_material != std::string::npos)
+			auto delim_pathstart = line.find_first_of(",");
+			auto delim_pathend = line.find_last_of(",");
+
+			if (delim_pathstart != std::string_view::npos && delim_pathend != std::string_view::npos)
 			{
-				std::string mata = line.substr(delim_material + 1);
-				if (mata.empty())
-				{
-					// Exclude
-					texture.material = "";
-				}
-				else
+				// Get texture material
+				auto delim_material = line.find_last_of(":");
+				if (delim_material != std::string_view::npos)
 				{
-					// Get enum value
-					auto mati = rbxenum_material.find(mata);
-					if (mati != rbxenum_material.end())
-						texture.material = std::to_string(mati->second);
+					std::string_view mata = line.substr(delim_material + 1);
+					if (mata.empty())
+					{
+						// Exclude
+						texture.material = nullptr;
+					}
 					else
-						std::cout << "Unknown material " << mata << " using Plastic" << std::endl;
+					{
+						// Get enum value
+						const SALVL_Material *material = Material_Find(mata);
+						if (material != nullptr)
+							texture.material = material;
+						else
+							std::cout << "Unknown material " << mata << " using Plastic" << std::endl;
+					}
 				}
+				
+				// Get texture name
+				push_texture(texture, line.substr(delim_pathstart + 1, (delim_pathend - delim_pathstart) - 1));
 			}
-			
-			// Get texture name
-			texture.name = line.substr(delim_pathstart + 1, (delim_pathend - delim_pathstart) - 1);
-			std::cout << "  " << texture.name << std::endl;
-
-			texture.name_fu = "u_" + texture.name;
-			texture.name_fv = "v_" + texture.name;
-			texture.name_fuv = "uv_" + texture.name;
-
-			texture.path = path_content + "salvl/" + texture.name;
-			texture.path_fu = path_content + "salvl/" + texture.name_fu;
-			texture.path_fv = path_content + "salvl/" + texture.name_fv;
-			texture.path_fuv = path_content + "salvl/" + texture.name_fuv;
-
-			// Check if any of the paths dont exist
-			bool exists = true;
-			if (!DoesThisFileExist(texture.path))
-				exists = false;
-			if (!DoesThisFileExist(texture.path_fu))
-				exists = false;
-			if (!DoesThisFileExist(texture.path_fv))
-				exists = false;
-			if (!DoesThisFileExist(texture.path_fuv))
-				exists = false;
-
-			// Read original image
+		}
+	}
+
+	// Read landtable from LVL file
+	std::cout << "Converting LVL " << path_lvl << " to landtable..." << std::endl;
+
+	if (loader(lvl, path_lvl))
+		return 1;
+
+	// Get which texture variants the level uses
+	std::vector<Uint8> tex_demand(lvl.textures.size(), variants_all ? SALVL_TEXVARIANT_ALL : 0);
+	for (auto &mesh : lvl.meshes)
+	{
+		for (auto &part : mesh.second.parts)
+		{
+			const SALVL_MeshPart &meshpart = part.second;
+			if (!(meshpart.matflags & NJD_FLAG_USE_TEXTURE) || meshpart.texture == nullptr)
+				continue;
+
+			Uint8 variant;
+			if (meshpart.matflags & NJD_FLAG_FLIP_U)
+				variant = (meshpart.matflags & NJD_FLAG_FLIP_V) ? SALVL_TEXVARIANT_FUV : SALVL_TEXVARIANT_FU;
+			else
+				variant = (meshpart.matflags & NJD_FLAG_FLIP_V) ? SALVL_TEXVARIANT_FV : SALVL_TEXVARIANT_BASE;
+			tex_demand[meshpart.texture - lvl.textures.data()] |= variant;
+		}
+	}
+
+	// Prepare textures
+	std::cout << "Preparing " << lvl.textures.size() << " textures..." << std::endl;
+
+	enum : Uint8
+	{
+		TexPrepare_OK,
+		TexPrepare_ReadFailed,
+		TexPrepare_AllocFailed,
+		TexPrepare_WriteFailed,
+	};
+	std::vector<Uint8> tex_status(lvl.textures.size(), TexPrepare_OK);
+	std::vector<Uint8> tex_kept(lvl.textures.size(), 0); // Variants found on disk without a cache entry
+
+	std::string path_texcache = path_content + "salvl/textures.cache";
+	std::unordered_map<std::string, SALVL_TextureCacheEntry> tex_cache;
+	std::vector<SALVL_TextureCacheEntry> tex_cache_new(lvl.textures.size());
+	TextureCache_Read(path_texcache, tex_cache);
+
+	// One scratch pool per worker, shared by every pass of the texture stage
+	std::vector<SALVL_ScratchPool> tex_scratch(std::max<size_t>(1, std::min<size_t>(jobs, lvl.textures.size())));
+
+	auto read_source = [&](size_t ti, SALVL_ScratchPool &scratch_pool, const Uint8 *&tex_file, size_t &tex_file_size)
+	{
+		// Archive textures are already in memory
+		if (texlist_archive)
+		{
+			tex_file = tex_archive[ti].data.data();
+			tex_file_size = tex_archive[ti].data.size();
+			return tex_file_size == 0;
+		}
+
+		// Read whole source file
+		std::ifstream stream_tex(path_texbase + std::string(lvl.textures[ti].name), std::ios::binary | std::ios::ate);
+		if (!stream_tex.is_open())
+			return true;
+		tex_file_size = (size_t)stream_tex.tellg();
+		stream_tex.seekg(0);
+		Uint8 *buffer = scratch_pool.Get(SALVL_SCRATCH_FILE, tex_file_size);
+		tex_file = buffer;
+		return tex_file_size == 0 || buffer == nullptr || !stream_tex.read((char*)buffer, tex_file_size);
+	};
+
+	auto decode_source = [&](const Uint8 *tex_file, size_t tex_file_size, int &tex_w, int &tex_h) -> unsigned char*
+	{
+		// Decode to RGBA8
+		if (texlist_archive)
+			return Archive_Decode(tex_file, tex_file_size, tex_w, tex_h);
+		return stbi_load_from_memory(tex_file, (int)tex_file_size, &tex_w, &tex_h, NULL, 4);
+	};
+
+	// Identify texture contents, only decoding sources the cache can't vouch for
+	std::vector<unsigned char*> tex_decoded(lvl.textures.size(), nullptr);
+
+	SALVL_ParallelFor(jobs, lvl.textures.size(), [&](size_t ti, unsigned int worker)
+	{
+		SALVL_Texture &texture = lvl.textures[ti];
+
+		// Unused textures aren't prepared at all
+		if (tex_demand[ti] == 0)
+			return;
+
+		// Read source file
+		const Uint8 *tex_file;
+		size_t tex_file_size;
+		if (read_source(ti, tex_scratch[worker], tex_file, tex_file_size))
+		{
+			tex_status[ti] = TexPrepare_ReadFailed;
+			return;
+		}
+
+		SALVL_TextureCacheEntry &entry = tex_cache_new[ti];
+		entry.hash = TextureCache_Hash(tex_file, tex_file_size);
+
+		auto cached = tex_cache.find(std::string(texture.name));
+		if (cached != tex_cache.end() && cached->second.hash == entry.hash)
+		{
+			entry.pixels = cached->second.pixels;
+			entry.xres = texture.xres = cached->second.xres;
+			entry.yres = texture.yres = cached->second.yres;
+			entry.alpha = texture.alpha = cached->second.alpha;
+			return;
+		}
+
+		// Decode original image
+		int tex_w, tex_h;
+		unsigned char *tex_src = decode_source(tex_file, tex_file_size, tex_w, tex_h);
+		if (tex_src == nullptr)
+		{
+			tex_status[ti] = TexPrepare_ReadFailed;
+			return;
+		}
+		tex_decoded[ti] = tex_src;
+
+		texture.xres = tex_w;
+		texture.yres = tex_h;
+
+		// Classify alpha
+		texture.alpha = ClassifyAlphaRGBA8(tex_src, (size_t)tex_w * tex_h);
+
+		entry.pixels = TextureCache_Hash(tex_src, (size_t)tex_w * tex_h * 4) ^ (((std::uint64_t)tex_w << 32) | (Uint32)tex_h);
+		entry.xres = texture.xres;
+		entry.yres = texture.yres;
+		entry.alpha = texture.alpha;
+	});
+
+	auto decoded_pixels = [&](size_t ti) -> const unsigned char*
+	{
+		// Cache hits weren't decoded by the identify pass
+		if (tex_decoded[ti] == nullptr)
+		{
+			const Uint8 *tex_file;
+			size_t tex_file_size;
 			int tex_w, tex_h;
-			unsigned char *tex_src = stbi_load((path_texbase + texture.name).c_str(), &tex_w, &tex_h, NULL, 4);
-			if (tex_src == nullptr)
+			if (read_source(ti, tex_scratch[0], tex_file, tex_file_size))
+				return nullptr;
+			tex_decoded[ti] = decode_source(tex_file, tex_file_size, tex_w, tex_h);
+			if (tex_decoded[ti] != nullptr && (tex_w != lvl.textures[ti].xres || tex_h != lvl.textures[ti].yres))
 			{
-				std::cout << "Failed to read texture " << (path_texbase + texture.name) << std::endl;
-				system("pause");
-				return 1;
+				stbi_image_free(tex_decoded[ti]);
+				tex_decoded[ti] = nullptr;
 			}
-			int tex_p = tex_w * 4;
+		}
+		return tex_decoded[ti];
+	};
+
+	// Collapse textures with identical pixels onto the first of them
+	std::vector<size_t> tex_canon(lvl.textures.size());
+	std::unordered_map<std::uint64_t, size_t> tex_by_pixels;
+	size_t tex_used = 0;
+	for (size_t ti = 0; ti < lvl.textures.size(); ti++)
+	{
+		tex_canon[ti] = ti;
+		if (tex_demand[ti] == 0 || tex_status[ti] != TexPrepare_OK)
+			continue;
 
-			texture.xres = tex_w;
-			texture.yres = tex_h;
+		auto it = tex_by_pixels.emplace(tex_cache_new[ti].pixels, ti);
+		size_t canon = it.first->second;
+		if (!it.second && lvl.textures[canon].xres == lvl.textures[ti].xres && lvl.textures[canon].yres == lvl.textures[ti].yres)
+		{
+			// Equal hashes only suggest a match, so compare the pixels themselves
+			const unsigned char *canon_src = decoded_pixels(canon);
+			const unsigned char *tex_src = decoded_pixels(ti);
+			if (canon_src != nullptr && tex_src != nullptr && memcmp(canon_src, tex_src, (size_t)lvl.textures[ti].xres * lvl.textures[ti].yres * 4) == 0)
+			{
+				tex_canon[ti] = canon;
+				tex_demand[canon] |= tex_demand[ti];
+				stbi_image_free(tex_decoded[ti]);
+				tex_decoded[ti] = nullptr;
+				continue;
+			}
+		}
+		tex_used++;
+	}
 
-			// Check if transparent
-			for (int i = 0; i < tex_w * tex_h; i++)
-				if (tex_src[i * 4 + 3] != 0xFF)
-					texture.transparent = true;
+	// Spread spare workers over the row blocks of each PNG when there are few textures
+	unsigned int png_jobs = std::max(1U, (unsigned int)(jobs / std::max<size_t>(tex_used, 1)));
 
-			if (!exists)
+	// Generate the variants that are missing
+	SALVL_ParallelFor(jobs, lvl.textures.size(), [&](size_t ti, unsigned int worker)
+	{
+		SALVL_Texture &texture = lvl.textures[ti];
+		SALVL_ScratchPool &scratch_pool = tex_scratch[worker];
+
+		if (tex_demand[ti] == 0 || tex_status[ti] != TexPrepare_OK || tex_canon[ti] != ti)
+			return;
+
+		// Roll mutation
+		std::uint64_t texture_seed = Texture_MutationSeed(mutation_seed, texture.name);
+		SALVL_Random random(texture_seed);
+		Uint32 roll[13];
+		for (auto &i : roll)
+			i = random.Next();
+
+		// Reuse variants the cache generated from this exact source
+		SALVL_TextureCacheEntry &entry = tex_cache_new[ti];
+
+		const std::string_view *variant_path[4] = { &texture.path, &texture.path_fu, &texture.path_fv, &texture.path_fuv };
+		std::string *entry_path[4] = { &entry.path, &entry.path_fu, &entry.path_fv, &entry.path_fuv };
+
+		Uint8 have = 0;
+		entry.max_res = max_res;
+		entry.mutation = mutation_salted ? texture_seed : 0;
+		auto cached = tex_cache.find(std::string(texture.name));
+		if (cached != tex_cache.end() && cached->second.hash == entry.hash && cached->second.max_res == max_res &&
+			(!mutation_salted || cached->second.mutation == entry.mutation))
+		{
+			const SALVL_TextureCacheEntry &old = cached->second;
+			const std::string *old_path[4] = { &old.path, &old.path_fu, &old.path_fv, &old.path_fuv };
+			for (int v = 0; v < 4; v++)
 			{
-				// Create flipped versions
-				unsigned char *tex_fu = (unsigned char *)STBI_MALLOC(tex_p * 2 * tex_h);
-				unsigned char *tex_fv = (unsigned char *)STBI_MALLOC(tex_p * tex_h * 2);
-				unsigned char *tex_fuv = (unsigned char *)STBI_MALLOC(tex_p * 2 * tex_h * 2);
-				if (tex_fv == nullptr || tex_fu == nullptr || tex_fuv == nullptr)
+				if (!old_path[v]->empty() && *old_path[v] == *variant_path[v] && DoesThisFileExist(*old_path[v]))
 				{
-					std::cout << "Failed to allocate texture flip buffers" << std::endl;
-					system("pause");
-					return 1;
+					*entry_path[v] = *old_path[v];
+					have |= 1 << v;
 				}
-
-				// Horizontal flip
-				for (int x = 0; x < tex_w * 2; x++)
+			}
+		}
+		else if (cached == tex_cache.end())
+		{
+			// Without an entry, files already on disk may have been edited by hand, so keep them
+			for (int v = 0; v < 4; v++)
+			{
+				if ((tex_demand[ti] & (1 << v)) && DoesThisFileExist(std::string(*variant_path[v])))
 				{
-					int src_x = x;
-					if (src_x >= tex_w)
-						src_x = tex_w * 2 - src_x - 1;
-					for (int y = 0; y < tex_h; y++)
-						memcpy(tex_fu + (y * tex_p * 2) + (x * 4), tex_src + (y * tex_p) + (src_x * 4), 4);
+					*entry_path[v] = *variant_path[v];
+					have |= 1 << v;
 				}
+			}
+			tex_kept[ti] = have;
+		}
+
+		// Skip decode and encode if nothing is missing
+		Uint8 gen = tex_demand[ti] & ~have;
+		if (gen == 0)
+			return;
 
-				// Vertical flip
-				memcpy(tex_fv, tex_src, tex_p * tex_h);
-				for (int y = 0; y < tex_h; y++)
-					memcpy(tex_fv + tex_p * (tex_h + y), tex_src + tex_p * (tex_h - y - 1), tex_p);
+		// Decode original image if the identify pass didn't
+		int tex_w = texture.xres, tex_h = texture.yres;
+		unsigned char *tex_src = tex_decoded[ti];
+		tex_decoded[ti] = nullptr;
+		if (tex_src == nullptr)
+		{
+			const Uint8 *tex_file;
+			size_t tex_file_size;
+			if (read_source(ti, scratch_pool, tex_file, tex_file_size) ||
+				(tex_src = decode_source(tex_file, tex_file_size, tex_w, tex_h)) == nullptr)
+			{
+				tex_status[ti] = TexPrepare_ReadFailed;
+				return;
+			}
+		}
+		// Variants are mirrored from a base image scaled to fit the resolution budget
+		int variant_w[4], variant_h[4], base_w[4], base_h[4];
+		for (int v = 0; v < 4; v++)
+		{
+			Texture_VariantRes(tex_w, tex_h, v, max_res, variant_w[v], variant_h[v]);
+			base_w[v] = variant_w[v] / ((v & 1) ? 2 : 1);
+			base_h[v] = variant_h[v] / ((v & 2) ? 2 : 1);
+		}
 
-				// Vertical and horizontal flip
-				memcpy(tex_fuv, tex_fu, tex_p * 2 * tex_h);
-				for (int y = 0; y < tex_h; y++)
-					memcpy(tex_fuv + tex_p * 2 * (tex_h + y), tex_fu + tex_p * 2 * (tex_h - y - 1), tex_p * 2);
+		// Group variants sharing a base size, full resolution last as the source is mutated in place
+		Uint8 groups[4] = {};
+		int group_v[4] = {}, num_groups = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int v = 0; v < 4; v++)
+			{
+				bool full = base_w[v] == tex_w && base_h[v] == tex_h;
+				if (!(gen & (1 << v)) || full != (pass == 1))
+					continue;
 
-				// Mutate textures
-				unsigned char *charp[4];
-				charp[0] = tex_src + (tex_p * (rand() % tex_h)) + ((rand() % tex_w) * 4) + (rand() % 3);
-				charp[1] = tex_fu + ((tex_p * 2) * (rand() % tex_h)) + ((rand() % (tex_w * 2)) * 4) + (rand() % 3);
-				charp[2] = tex_fv + (tex_p * (rand() % (tex_h * 2))) + ((rand() % tex_w) * 4) + (rand() % 3);
-				charp[3] = tex_fuv + ((tex_p * 2) * (rand() % (tex_h * 2))) + ((rand() % (tex_w * 2)) * 4) + (rand() % 3);
+				int g = 0;
+				while (g < num_groups && (base_w[group_v[g]] != base_w[v] || base_h[group_v[g]] != base_h[v]))
+					g++;
+				if (g == num_groups)
+					group_v[num_groups++] = v;
+				groups[g] |= 1 << v;
+			}
+		}
 
-				for (int i = 0; i < 4; i++)
+		for (int g = 0; g < num_groups && tex_status[ti] == TexPrepare_OK; g++)
+		{
+			Uint8 group = groups[g];
+			int group_w = base_w[group_v[g]], group_h = base_h[group_v[g]];
+			int base_p = group_w * 4;
+
+			// Create base and flipped versions that are needed, in the worker's scratch buffers
+			unsigned char *tex_base = tex_src, *tex_fu = nullptr, *tex_fv = nullptr, *tex_fuv = nullptr;
+			if (group_w != tex_w || group_h != tex_h)
+				tex_base = scratch_pool.Get(SALVL_SCRATCH_BASE, (size_t)base_p * group_h);
+			if (group & SALVL_TEXVARIANT_FU)
+				tex_fu = scratch_pool.Get(SALVL_SCRATCH_FU, (size_t)base_p * 2 * group_h);
+			if (group & SALVL_TEXVARIANT_FV)
+				tex_fv = scratch_pool.Get(SALVL_SCRATCH_FV, (size_t)base_p * group_h * 2);
+			if (group & SALVL_TEXVARIANT_FUV)
+				tex_fuv = scratch_pool.Get(SALVL_SCRATCH_FUV, (size_t)base_p * 2 * group_h * 2);
+			if (tex_base == nullptr ||
+				((group & SALVL_TEXVARIANT_FU) && tex_fu == nullptr) ||
+				((group & SALVL_TEXVARIANT_FV) && tex_fv == nullptr) ||
+				((group & SALVL_TEXVARIANT_FUV) && tex_fuv == nullptr))
+			{
+				tex_status[ti] = TexPrepare_AllocFailed;
+			}
+			else
+			{
+				if (tex_base != tex_src)
 				{
-					if (rand() & 1)
-						*charp[i] = (*charp[i] != 0) ? (*charp[i] - 1) : 0;
-					else
-						*charp[i] = (*charp[i] != 0xFF) ? (*charp[i] + 1) : 0xFF;
+					if (ResampleRGBA8(tex_src, tex_w, tex_h, tex_base, group_w, group_h, scratch_pool))
+					{
+						tex_status[ti] = TexPrepare_AllocFailed;
+						break;
+					}
+					if (texture.alpha == SALVL_ALPHA_CUTOUT)
+						ThresholdAlphaRGBA8(tex_base, (size_t)group_w * group_h);
 				}
+				MirrorRGBA8(tex_base, group_w, group_h, tex_fu, tex_fv, tex_fuv);
 
-				// Write textures
-				if (stbi_write_png(texture.path.c_str(), tex_w, tex_h, 4, tex_src, tex_p) == 0 ||
-					stbi_write_png(texture.path_fu.c_str(), tex_w * 2, tex_h, 4, tex_fu, tex_p * 2) == 0 ||
-					stbi_write_png(texture.path_fv.c_str(), tex_w, tex_h * 2, 4, tex_fv, tex_p) == 0 ||
-					stbi_write_png(texture.path_fuv.c_str(), tex_w * 2, tex_h * 2, 4, tex_fuv, tex_p * 2) == 0)
+				// Mutate and write textures
+				struct Variant
 				{
-					std::cout << "Failed to write textures" << std::endl;
-					system("pause");
-					return 1;
-				}
+					unsigned char *data;
+					int w, h;
+				} variant[4] = {
+					{ tex_base, group_w, group_h },
+					{ tex_fu, group_w * 2, group_h },
+					{ tex_fv, group_w, group_h * 2 },
+					{ tex_fuv, group_w * 2, group_h * 2 },
+				};
+
+				for (int v = 0; v < 4; v++)
+				{
+					if (!(group & (1 << v)))
+						continue;
+
+					const Variant &var = variant[v];
+					unsigned char *charp = var.data + (var.w * 4 * (roll[v * 3 + 0] % var.h)) + ((roll[v * 3 + 1] % var.w) * 4) + (roll[v * 3 + 2] % 3);
+					if ((roll[12] >> v) & 1)
+						*charp = (*charp != 0) ? (*charp - 1) : 0;
+					else
+						*charp = (*charp != 0xFF) ? (*charp + 1) : 0xFF;
 
-				STBI_FREE(tex_fu);
-				STBI_FREE(tex_fv);
-				STBI_FREE(tex_fuv);
+					if (PNG_Write(std::string(*variant_path[v]), var.data, var.w, var.h, png_effort, png_jobs, scratch_pool))
+					{
+						tex_status[ti] = TexPrepare_WriteFailed;
+						break;
+					}
+					*entry_path[v] = *variant_path[v];
+				}
 			}
-			stbi_image_free(tex_src);
+		}
+
+		stbi_image_free(tex_src);
+	});
 
-			// Push to texture list
-			lvl.textures.push_back(texture);
+	for (auto &i : tex_decoded)
+		stbi_image_free(i);
+
+	for (size_t i = 0; i < lvl.textures.size(); i++)
+	{
+		switch (tex_status[i])
+		{
+			case TexPrepare_OK:
+				if (tex_kept[i] != 0)
+					std::cout << "  " << lvl.textures[i].name << " (kept existing files, delete them to regenerate)" << std::endl;
+				else if (tex_demand[i] != 0)
+					std::cout << "  " << lvl.textures[i].name << std::endl;
+				continue;
+			case TexPrepare_ReadFailed:
+				if (texlist_archive)
+					std::cout << "Failed to decode texture " << lvl.textures[i].name << " from " << path_texlist << std::endl;
+				else
+					std::cout << "Failed to read texture " << path_texbase << lvl.textures[i].name << std::endl;
+				break;
+			case TexPrepare_AllocFailed:
+				std::cout << "Failed to allocate texture flip buffers" << std::endl;
+				break;
+			case TexPrepare_WriteFailed:
+				std::cout << "Failed to write textures" << std::endl;
+				break;
 		}
+		system("pause");
+		return 1;
+	}
+
+	// Update texture cache manifest
+	for (size_t i = 0; i < lvl.textures.size(); i++)
+		if (tex_demand[i] != 0)
+			tex_cache[std::string(lvl.textures[i].name)] = tex_cache_new[i];
+	if (TextureCache_Write(path_texcache, tex_cache))
+		std::cout << "Failed to write texture cache " << path_texcache << std::endl;
+
+	// Duplicates share the generated files, and so the uploaded asset, of their first copy
+	size_t tex_dupes = 0;
+	for (size_t ti = 0; ti < lvl.textures.size(); ti++)
+	{
+		if (tex_canon[ti] == ti)
+			continue;
+		const SALVL_Texture &canon = lvl.textures[tex_canon[ti]];
+		SALVL_Texture &texture = lvl.textures[ti];
+		texture.name = canon.name;
+		texture.name_fu = canon.name_fu;
+		texture.name_fv = canon.name_fv;
+		texture.name_fuv = canon.name_fuv;
+		texture.path = canon.path;
+		texture.path_fu = canon.path_fu;
+		texture.path_fv = canon.path_fv;
+		texture.path_fuv = canon.path_fuv;
+		tex_dupes++;
+	}
+	if (tex_dupes != 0)
+		std::cout << "  " << tex_dupes << " duplicate textures share generated files" << std::endl;
+
+	// Record effective resolution after downscaling
+	for (auto &texture : lvl.textures)
+	{
+		for (int v = 0; v < 4; v++)
+			Texture_VariantRes(texture.xres, texture.yres, v, max_res, texture.xres_variant[v], texture.yres_variant[v]);
+		texture.xres = texture.xres_variant[0];
+		texture.yres = texture.yres_variant[0];
 	}
 
 	// Confirm for texture mods
 	std::cout << "Please modify textures (to remove external links and such) now." << std::endl;
 	system("pause");
 
-	// Read landtable from LVL file
-	std::cout << "Converting LVL " << path_lvl << " to landtable..." << std::endl;
+	// Build texture atlases
+	if (atlas_size != 0)
+	{
+		std::cout << "Building texture atlases..." << std::endl;
+		if (Atlas_Build(lvl, path_content, atlas_size, png_effort, jobs, tex_scratch))
+		{
+			std::cout << "Failed to build texture atlases" << std::endl;
+			system("pause");
+			return 1;
+		}
+		std::cout << "  " << lvl.atlases.size() << " atlas pages" << std::endl;
+	}
 
-	if (loader(lvl, path_lvl))
-		return 1;
+	// Texture stage is done, release its scratch
+	tex_scratch.clear();
 
 	// Post process meshes
+	std::cout << "Post processing meshes..." << std::endl;
+
+	std::vector<SALVL_MeshPart*> post_parts;
+	std::vector<SALVL_Mesh*> post_meshes;
+	auto gather_parts = [&]()
+	{
+		// Largest parts first so the long tail is spread across workers
+		post_parts.clear();
+		for (auto &mesh : lvl.meshes)
+			for (auto &part : mesh.second.parts)
+				post_parts.push_back(&part.second);
+		std::stable_sort(post_parts.begin(), post_parts.end(), [](SALVL_MeshPart *a, SALVL_MeshPart *b) { return a->indices.size() > b->indices.size(); });
+	};
+
+	gather_parts();
+	SALVL_ParallelFor(jobs, post_parts.size(), [&](size_t i)
+	{
+		post_parts[i]->ClearVertexIndex();
 #if SALVL_DOUBLESIDED
-	for (auto &mesh : lvl.meshes)
+		post_parts[i]->AutoNormals();
+#endif
+	});
+
+	// Split oversized mesh parts
+	if (split_vertices != 0)
 	{
-		for (auto &part : mesh.second.parts)
+		for (auto &mesh : lvl.meshes)
+			post_meshes.push_back(&mesh.second);
+		SALVL_ParallelFor(jobs, post_meshes.size(), [&](size_t i)
 		{
-			part.second.AutoNormals();
-		}
+			post_meshes[i]->Split(split_vertices);
+		});
 	}
-#endif
 
-	// Write RBX meshes
-	std::cout << "Writing RBX meshes..." << std::endl;
-	unsigned int mesh_ind = 0;
-	for (auto &i : lvl.meshes)
+	// Correct meshpart AABBs
+	gather_parts();
+	SALVL_ParallelFor(jobs, post_parts.size(), [&](size_t i)
 	{
-		// Write mesh parts
-		SALVL_Mesh *mesh = &i.second;
+		post_parts[i]->AABBCorrect();
+	});
 
-		for (auto &j : mesh->parts)
-		{
-			// Correct meshpart AABB
-			SALVL_MeshPart *meshpart = &j.second;
-			meshpart->AABBCorrect();
+	// Assign mesh indices in level order
+	std::cout << "Writing RBX meshes..." << std::endl;
 
+	std::vector<SALVL_MeshPart*> write_parts;
+	{
+		std::unordered_set<SALVL_Mesh*> write_meshes;
+		unsigned int mesh_ind = 0;
+		for (auto &i : lvl.meshinstances)
+		{
 			// Don't write mesh if not to be uploaded
-			if (!mesh->do_upload)
+			SALVL_Mesh *mesh = i.mesh;
+			if (mesh == nullptr || !mesh->do_upload || !write_meshes.insert(mesh).second)
 				continue;
 
-			// Open mesh file
-			meshpart->name = std::to_string(mesh_ind) + ".mesh";
-			std::cout << "  " << meshpart->name << std::endl;
-
-			meshpart->ind = mesh_ind;
+			// Write mesh parts in key order
+			std::vector<int> keys;
+			for (auto &j : mesh->parts)
+				keys.push_back(j.first);
+			std::sort(keys.begin(), keys.end());
 
-			std::string path_mesh = path_content + "salvl/" + meshpart->name;
-			meshpart->path = path_mesh;
-
-			std::ofstream stream_mesh(path_mesh, std::ios::binary);
-			if (!stream_mesh.is_open())
+			for (auto &j : keys)
 			{
-				std::cout << "Failed to open mesh " << path_mesh << std::endl;
-				system("pause");
-				return 1;
-			}
-			stream_mesh.write("version 2.00\n", 13);
+				SALVL_MeshPart *meshpart = &mesh->parts[j];
 
-			// Write mesh header
-			Write16(stream_mesh, 12); // sizeof_MeshHeader
-			stream_mesh.put((char)0x28); // sizeof_MeshVertex
-			stream_mesh.put((char)0x0C); // sizeof_MeshFace
+				meshpart->name = std::to_string(mesh_ind) + ".mesh";
+				std::cout << "  " << meshpart->name << std::endl;
 
-			unsigned int num_verts = meshpart->vertex.size();
-			Write32(stream_mesh, num_verts);
-			unsigned int num_faces = meshpart->indices.size();
-			Write32(stream_mesh, num_faces);
+				meshpart->ind = mesh_ind;
+				meshpart->path = path_content + "salvl/" + meshpart->name;
+				write_parts.push_back(meshpart);
 
-			// Write vertex data
-			for (auto &k : meshpart->vertex)
-			{
-				WriteFloat(stream_mesh, k.pos.x); WriteFloat(stream_mesh, k.pos.y); WriteFloat(stream_mesh, k.pos.z); // Position
-				WriteFloat(stream_mesh, k.nor.x); WriteFloat(stream_mesh, k.nor.y); WriteFloat(stream_mesh, k.nor.z); // Normal
-				WriteFloat(stream_mesh, k.tex.x); WriteFloat(stream_mesh, k.tex.y); // Texture
-				stream_mesh.put((char)0); stream_mesh.put((char)0); stream_mesh.put((char)-127); stream_mesh.put((char)1); // Tangent
-				stream_mesh.put((char)k.r); stream_mesh.put((char)k.g); stream_mesh.put((char)k.b); stream_mesh.put((char)k.a); // RGBA tint
+				// Increment mesh index
+				mesh_ind++;
 			}
+		}
+	}
 
-			// Write indices
-			for (auto &k : meshpart->indices)
-			{
-				Write32(stream_mesh, k.i[0]);
-				Write32(stream_mesh, k.i[1]);
-				Write32(stream_mesh, k.i[2]);
-			}
+	// Serialize and write meshes
+	std::vector<Uint8> write_failed(write_parts.size(), 0);
+	SALVL_ParallelFor(jobs, write_parts.size(), [&](size_t i)
+	{
+		SALVL_MeshPart *meshpart = write_parts[i];
+		SALVL_SerializeRBXMesh(meshpart->data, *meshpart);
 
-			// Increment mesh index
-			mesh_ind++;
+		std::ofstream stream_mesh(meshpart->path, std::ios::binary);
+		if (!stream_mesh.is_open() || !stream_mesh.write(meshpart->data.data(), meshpart->data.size()))
+			write_failed[i] = 1;
+
+		// Only keep serialized data around for upload
+		if (!upload)
+			std::vector<char>().swap(meshpart->data);
+	});
+
+	for (size_t i = 0; i < write_parts.size(); i++)
+	{
+		if (write_failed[i])
+		{
+			std::cout << "Failed to write mesh " << write_parts[i]->path << std::endl;
+			system("pause");
+			return 1;
 		}
 	}
 
@@ -818,47 +4565,31 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 		// Upload meshes
 		std::unordered_map<std::string, std::string> upload_texs;
 
-		int num_meshes = 0;
-		for (auto &i : lvl.meshes)
+		std::cout << "  Uploading " << write_parts.size() << " meshes..." << std::endl;
+		for (auto &meshpart : write_parts)
 		{
-			if (!i.second.do_upload)
-				continue;
-			for (auto &j : i.second.parts)
-				num_meshes++;
-		}
+			// Upload mesh
+			std::string object = "/ide/publish/UploadNewMesh?name=" + URLEncode(meshpart->name) + "&description=" + URLEncode("Generated by SALVL2RBX");
+			if ((meshpart->url = "rbxassetid://" + asset_manager.UploadAsset(object, meshpart->data)).empty())
+			{
+				std::cout << "Failed to upload mesh" << std::endl;
+				system("pause");
+				return 1;
+			}
+			std::cout << "  Uploaded mesh " << meshpart->name << " to " << meshpart->url << std::endl;
 
-		std::cout << "  Uploading " << num_meshes << " meshes..." << std::endl;
-		for (auto &i : lvl.meshes)
-		{
-			if (!i.second.do_upload)
-				continue;
-			for (auto &j : i.second.parts)
+			// Set texture to be loaded
+			if ((meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr)
 			{
-				// Upload mesh
-				std::ifstream meshbuf_stream(j.second.path, std::ios::binary);
-				std::vector<char> meshbuf((std::istreambuf_iterator<char>(meshbuf_stream)), std::istreambuf_iterator<char>());
-				std::string object = "/ide/publish/UploadNewMesh?name=" + URLEncode(j.second.name) + "&description=" + URLEncode("Generated by SALVL2RBX");
-				if ((j.second.url = "rbxassetid://" + asset_manager.UploadAsset(object, meshbuf)).empty())
+				if (meshpart->matflags & NJD_FLAG_FLIP_U)
 				{
-					std::cout << "Failed to upload mesh" << std::endl;
-					system("pause");
-					return 1;
+					meshpart->name_texture = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->name_fuv : meshpart->texture->name_fu);
+					upload_texs[meshpart->name_texture] = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->path_fuv : meshpart->texture->path_fu);
 				}
-				std::cout << "  Uploaded mesh " << j.second.name << " to " << j.second.url << std::endl;
-
-				// Set texture to be loaded
-				if ((j.second.matflags & NJD_FLAG_USE_TEXTURE) && j.second.texture != nullptr)
+				else
 				{
-					if (j.second.matflags & NJD_FLAG_FLIP_U)
-					{
-						j.second.name_texture = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->name_fuv : j.second.texture->name_fu);
-						upload_texs[j.second.name_texture] = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->path_fuv : j.second.texture->path_fu);
-					}
-					else
-					{
-						j.second.name_texture = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->name_fv : j.second.texture->name);
-						upload_texs[j.second.name_texture] = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->path_fv : j.second.texture->path);
-					}
+					meshpart->name_texture = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->name_fv : meshpart->texture->name);
+					upload_texs[meshpart->name_texture] = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->path_fv : meshpart->texture->path);
 				}
 			}
 		}
@@ -918,45 +4649,38 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 		}
 
 		// Assign uploaded textures to meshes
-		for (auto &i : lvl.meshes)
-		{
-			if (!i.second.do_upload)
-				continue;
-			for (auto &j : i.second.parts)
-				j.second.url_texture = uploaded_texs[j.second.name_texture];
-		}
+		for (auto &meshpart : write_parts)
+			meshpart->url_texture = uploaded_texs[meshpart->name_texture];
 	}
 	else
 	{
 		// Get rbxasset URLs
 		std::cout << "Getting rbxasset://URLs..." << std::endl;
 
-		for (auto &i : lvl.textures)
+		for (auto textures : { &lvl.textures, &lvl.atlases })
 		{
-			i.url = "rbxasset://salvl/" + i.name;
-			i.url_fu = "rbxasset://salvl/" + i.name_fu;
-			i.url_fv = "rbxasset://salvl/" + i.name_fv;
-			i.url_fuv = "rbxasset://salvl/" + i.name_fuv;
+			for (auto &i : *textures)
+			{
+				i.url = lvl.strings.Intern({ "rbxasset://salvl/", i.name });
+				i.url_fu = lvl.strings.Intern({ "rbxasset://salvl/", i.name_fu });
+				i.url_fv = lvl.strings.Intern({ "rbxasset://salvl/", i.name_fv });
+				i.url_fuv = lvl.strings.Intern({ "rbxasset://salvl/", i.name_fuv });
+			}
 		}
-		for (auto &i : lvl.meshes)
+		for (auto &meshpart : write_parts)
 		{
-			if (!i.second.do_upload)
-				continue;
-			for (auto &j : i.second.parts)
+			meshpart->url = "rbxasset://salvl/" + meshpart->name;
+			if ((meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr)
 			{
-				j.second.url = "rbxasset://salvl/" + j.second.name;
-				if ((j.second.matflags & NJD_FLAG_USE_TEXTURE) && j.second.texture != nullptr)
+				if (meshpart->matflags & NJD_FLAG_FLIP_U)
 				{
-					if (j.second.matflags & NJD_FLAG_FLIP_U)
-					{
-						j.second.name_texture = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->name_fuv : j.second.texture->name_fu);
-						j.second.url_texture = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->url_fuv : j.second.texture->url_fu);
-					}
-					else
-					{
-						j.second.name_texture = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->name_fv : j.second.texture->name);
-						j.second.url_texture = ((j.second.matflags & NJD_FLAG_FLIP_V) ? j.second.texture->url_fv : j.second.texture->url);
-					}
+					meshpart->name_texture = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->name_fuv : meshpart->texture->name_fu);
+					meshpart->url_texture = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->url_fuv : meshpart->texture->url_fu);
+				}
+				else
+				{
+					meshpart->name_texture = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->name_fv : meshpart->texture->name);
+					meshpart->url_texture = ((meshpart->matflags & NJD_FLAG_FLIP_V) ? meshpart->texture->url_fv : meshpart->texture->url);
 				}
 			}
 		}
@@ -997,50 +4721,26 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 			if (i.surf_flag & SALVL_SURFFLAG_SOLID)
 			{
 				// Disable texture if a disallowed texture
-				if ((meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr && meshpart->texture->material.empty())
+				if ((meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr && meshpart->texture->material == nullptr)
 					meshpart->matflags &= ~NJD_FLAG_USE_TEXTURE;
 				mesh_collision.push_back(meshpart_instance);
 			}
 			else if (i.surf_flag & SALVL_SURFFLAG_VISIBLE)
 			{
 				// Exclude part if a disallowed texture
-				if ((meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr && meshpart->texture->material.empty())
+				if ((meshpart->matflags & NJD_FLAG_USE_TEXTURE) && meshpart->texture != nullptr && meshpart->texture->material == nullptr)
 					continue;
 				mesh_visual.push_back(meshpart_instance);
 			}
 		}
 	}
 
-	// Write RBXMX
-	std::cout << "Writing RBXMX " << path_rbxmx << "..." << std::endl;
+	// Generate CSG meshes for collision
+	std::cout << "Generating collision data..." << std::endl;
 
 	std::unordered_map<SALVL_MeshPart *, SALVL_CSGMesh> meshpart_csgmesh;
+	std::vector<SALVL_CSGMesh*> collision_csgmesh;
 
-	std::ofstream stream_rbxmx(path_rbxmx);
-	if (!stream_rbxmx.is_open())
-	{
-		std::cout << "Failed to open RBXMX " << path_rbxmx << std::endl;
-		system("pause");
-		return 1;
-	}
-
-	// ROBLOX model tree
-	stream_rbxmx << "<roblox xmlns:xmime=\"http://www.w3.org/2005/05/xmlmime\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:noNamespaceSchemaLocation=\"http://www.roblox.com/roblox.xsd\" version=\"4\">" << std::endl;
-	// Level folder
-	stream_rbxmx << "<Item class = \"Folder\">" << std::endl;
-	stream_rbxmx << "<Properties>" << std::endl;
-	stream_rbxmx << "<string name=\"Name\">Level</string>" << std::endl;
-	stream_rbxmx << "</Properties>" << std::endl;
-	// Map folder
-	stream_rbxmx << "<Item class = \"Folder\">" << std::endl;
-	stream_rbxmx << "<Properties>" << std::endl;
-	stream_rbxmx << "<string name=\"Name\">Map</string>" << std::endl;
-	stream_rbxmx << "</Properties>" << std::endl;
-	// Collision Folder
-	stream_rbxmx << "<Item class = \"Folder\">" << std::endl;
-	stream_rbxmx << "<Properties>" << std::endl;
-	stream_rbxmx << "<string name=\"Name\">Collision</string>" << std::endl;
-	stream_rbxmx << "</Properties>" << std::endl;
 	for (auto &i : mesh_collision)
 	{
 		// Calculate CSG mesh
@@ -1049,53 +4749,10 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 		SALVL_CSGMesh *csgmesh;
 		if (csgmeshind == meshpart_csgmesh.end())
 		{
-			// Generate CSG mesh data
-			std::vector<Uint8> csgmesh_data;
-			csgmesh_data.push_back('C'); csgmesh_data.push_back('S'); csgmesh_data.push_back('G'); csgmesh_data.push_back('P'); csgmesh_data.push_back('H'); csgmesh_data.push_back('S');
-			Push32(csgmesh_data, 3);
-
-			// Write sub-meshes
-			for (auto &j : i.meshpart->indices)
-			{
-				// Get vertices
-				SALVL_Vertex *v0 = &i.meshpart->vertex[j.i[0]];
-				SALVL_Vertex *v1 = &i.meshpart->vertex[j.i[1]];
-				SALVL_Vertex *v2 = &i.meshpart->vertex[j.i[2]];
-
-				// Write dummied out header
-				Push32(csgmesh_data, 16); // sizeof_TriIndices
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); // TriIndices[16]
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00);
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00);
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00);
-
-				Push32(csgmesh_data, 16); // sizeof_TransformOffsets
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); // TransformOffsets[16]
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00);
-				csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x00); csgmesh_data.push_back(0x80); csgmesh_data.push_back(0x3F);
-
-				// Write vertices
-				Push32(csgmesh_data, 18); // numCoords
-				Push32(csgmesh_data, 4); // sizeof_float
-
-				PushFloat(csgmesh_data, v0->pos.x); PushFloat(csgmesh_data, v0->pos.y); PushFloat(csgmesh_data, v0->pos.z); // Vertex 0
-				PushFloat(csgmesh_data, v1->pos.x); PushFloat(csgmesh_data, v1->pos.y); PushFloat(csgmesh_data, v1->pos.z); // Vertex 1
-				PushFloat(csgmesh_data, v2->pos.x); PushFloat(csgmesh_data, v2->pos.y); PushFloat(csgmesh_data, v2->pos.z); // Vertex 2
-
-				PushFloat(csgmesh_data, v0->pos.x - v0->nor.x * 0.125f); PushFloat(csgmesh_data, v0->pos.y - v0->nor.y * 0.125f); PushFloat(csgmesh_data, v0->pos.z - v0->nor.z * 0.125f); // Vertex 3
-				PushFloat(csgmesh_data, v1->pos.x - v1->nor.x * 0.125f); PushFloat(csgmesh_data, v1->pos.y - v1->nor.y * 0.125f); PushFloat(csgmesh_data, v1->pos.z - v1->nor.z * 0.125f); // Vertex 4
-				PushFloat(csgmesh_data, v2->pos.x - v2->nor.x * 0.125f); PushFloat(csgmesh_data, v2->pos.y - v2->nor.y * 0.125f); PushFloat(csgmesh_data, v2->pos.z - v2->nor.z * 0.125f); // Vertex 5
-
-				// Write indices
-				Push32(csgmesh_data, 6); // numIndices
-				Push32(csgmesh_data, 0); Push32(csgmesh_data, 1); Push32(csgmesh_data, 2); // Triangle 0 (front)
-				Push32(csgmesh_data, 5); Push32(csgmesh_data, 4); Push32(csgmesh_data, 3); // Triangle 1 (back)
-			}
-
-			// Create new mesh, encode, and push to map
+			// Create new mesh, build, and push to map
 			SALVL_CSGMesh csgmeshe;
-			csgmeshe.Encode(csgmesh_data);
-			meshpart_csgmesh[i.meshpart] = csgmeshe;
+			csgmeshe.Build(*i.meshpart);
+			meshpart_csgmesh[i.meshpart] = std::move(csgmeshe);
 			csgmesh = &meshpart_csgmesh[i.meshpart];
 		}
 		else
@@ -1104,160 +4761,18 @@ int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string))
 			csgmesh = &csgmeshind->second;
 		}
 
-		// MeshPart
-		stream_rbxmx << "<Item class = \"MeshPart\">" << std::endl;
-		stream_rbxmx << "<Properties>" << std::endl;
-		stream_rbxmx << "<bool name=\"Anchored\">true</bool>" << std::endl;
-		stream_rbxmx << "<bool name=\"CanCollide\">true</bool>" << std::endl;
-		stream_rbxmx << "<bool name=\"CanTouch\">false</bool>" << std::endl;
-		#ifdef SALVL_DOUBLESIDED
-			stream_rbxmx << "<bool name=\"DoubleSided\">true</bool>" << std::endl;
-		#endif
-		stream_rbxmx << "<CoordinateFrame name = \"CFrame\">" << std::endl;
-		stream_rbxmx << "<X>" << i.pos.x * scale << "</X>" << std::endl;
-		stream_rbxmx << "<Y>" << i.pos.y * scale << "</Y>" << std::endl;
-		stream_rbxmx << "<Z>" << i.pos.z * scale << "</Z>" << std::endl;
-		stream_rbxmx << "<R00>" << i.matrix[M00] << "</R00>" << std::endl;
-		stream_rbxmx << "<R01>" << i.matrix[M01] << "</R01>" << std::endl;
-		stream_rbxmx << "<R02>" << i.matrix[M02] << "</R02>" << std::endl;
-		stream_rbxmx << "<R10>" << i.matrix[M10] << "</R10>" << std::endl;
-		stream_rbxmx << "<R11>" << i.matrix[M11] << "</R11>" << std::endl;
-		stream_rbxmx << "<R12>" << i.matrix[M12] << "</R12>" << std::endl;
-		stream_rbxmx << "<R20>" << i.matrix[M20] << "</R20>" << std::endl;
-		stream_rbxmx << "<R21>" << i.matrix[M21] << "</R21>" << std::endl;
-		stream_rbxmx << "<R22>" << i.matrix[M22] << "</R22>" << std::endl;
-		stream_rbxmx << "</CoordinateFrame>" << std::endl;
-		stream_rbxmx << "<Vector3 name = \"size\">" << std::endl;
-		stream_rbxmx << "<X>" << i.meshpart->size.x * scale << "</X>" << std::endl;
-		stream_rbxmx << "<Y>" << i.meshpart->size.y * scale << "</Y>" << std::endl;
-		stream_rbxmx << "<Z>" << i.meshpart->size.z * scale << "</Z>" << std::endl;
-		stream_rbxmx << "</Vector3>" << std::endl;
-		stream_rbxmx << "<Vector3 name = \"InitialSize\">" << std::endl;
-		stream_rbxmx << "<X>" << i.meshpart->size.x << "</X>" << std::endl;
-		stream_rbxmx << "<Y>" << i.meshpart->size.y << "</Y>" << std::endl;
-		stream_rbxmx << "<Z>" << i.meshpart->size.z << "</Z>" << std::endl;
-		stream_rbxmx << "</Vector3>" << std::endl;
-		if (!i.meshpart->url.empty())
-			stream_rbxmx << "<Content name=\"MeshID\"><url>" << i.meshpart->url << "</url></Content>" << std::endl;
-		if ((i.meshpart->matflags & NJD_FLAG_USE_TEXTURE) && i.meshpart->texture != nullptr)
-		{
-			stream_rbxmx << "<string name=\"Name\">" << i.meshpart->name_texture << "</string>" << std::endl;
-			stream_rbxmx << "<Content name=\"TextureID\"><url>";
-			stream_rbxmx << i.meshpart->url_texture;
-			stream_rbxmx << "</url></Content>" << std::endl;
-			stream_rbxmx << "<token name=\"Material\">" << i.meshpart->texture->material << "</token>" << std::endl;
-		}
-		else
-		{
-			stream_rbxmx << "<string name=\"Name\">Collision</string>" << std::endl;
-		}
-		stream_rbxmx << "<SharedString name=\"PhysicalConfigData\">" << csgmesh->enc_hash << "</SharedString>" << std::endl;
-		stream_rbxmx << "<float name=\"Transparency\">" << ((i.surf_flag & SALVL_SURFFLAG_VISIBLE) ? 0.0f : 1.0f) << "</float>" << std::endl;
-		stream_rbxmx << "<Color3uint8 name = \"Color3uint8\">" << i.meshpart->diffuse << "</Color3uint8>" << std::endl;
-		stream_rbxmx << "</Properties>" << std::endl;
-		if ((i.meshpart->matflags & NJD_FLAG_USE_TEXTURE) && i.meshpart->texture != nullptr && i.meshpart->texture->transparent)
-		{
-			// SurfaceAppearance
-			stream_rbxmx << "<Item class = \"SurfaceAppearance\">" << std::endl;
-				stream_rbxmx << "<Properties>" << std::endl;
-					stream_rbxmx << "<token name=\"AlphaMode\">1</token>" << std::endl;
-					stream_rbxmx << "<Content name=\"ColorMap\"><url>";
-						stream_rbxmx << i.meshpart->url_texture;
-					stream_rbxmx << "</url></Content>" << std::endl;
-				stream_rbxmx << "</Properties>" << std::endl;
-			stream_rbxmx << "</Item>" << std::endl;
-		}
-		stream_rbxmx << "</Item>" << std::endl;
-	}
-	stream_rbxmx << "</Item>" << std::endl;
-	// Visual Folder
-	stream_rbxmx << "<Item class = \"Folder\">" << std::endl;
-	stream_rbxmx << "<Properties>" << std::endl;
-	stream_rbxmx << "<string name=\"Name\">Visual</string>" << std::endl;
-	stream_rbxmx << "</Properties>" << std::endl;
-	for (auto &i : mesh_visual)
-	{
-		// MeshPart
-		stream_rbxmx << "<Item class = \"MeshPart\">" << std::endl;
-		stream_rbxmx << "<Properties>" << std::endl;
-		stream_rbxmx << "<bool name=\"Anchored\">true</bool>" << std::endl;
-		stream_rbxmx << "<bool name=\"CanCollide\">false</bool>" << std::endl;
-		stream_rbxmx << "<bool name=\"CanTouch\">false</bool>" << std::endl;
-		#ifdef SALVL_DOUBLESIDED
-			stream_rbxmx << "<bool name=\"DoubleSided\">true</bool>" << std::endl;
-		#endif
-		stream_rbxmx << "<CoordinateFrame name = \"CFrame\">" << std::endl;
-		stream_rbxmx << "<X>" << i.pos.x * scale << "</X>" << std::endl;
-		stream_rbxmx << "<Y>" << i.pos.y * scale << "</Y>" << std::endl;
-		stream_rbxmx << "<Z>" << i.pos.z * scale << "</Z>" << std::endl;
-		stream_rbxmx << "<R00>" << i.matrix[M00] << "</R00>" << std::endl;
-		stream_rbxmx << "<R01>" << i.matrix[M01] << "</R01>" << std::endl;
-		stream_rbxmx << "<R02>" << i.matrix[M02] << "</R02>" << std::endl;
-		stream_rbxmx << "<R10>" << i.matrix[M10] << "</R10>" << std::endl;
-		stream_rbxmx << "<R11>" << i.matrix[M11] << "</R11>" << std::endl;
-		stream_rbxmx << "<R12>" << i.matrix[M12] << "</R12>" << std::endl;
-		stream_rbxmx << "<R20>" << i.matrix[M20] << "</R20>" << std::endl;
-		stream_rbxmx << "<R21>" << i.matrix[M21] << "</R21>" << std::endl;
-		stream_rbxmx << "<R22>" << i.matrix[M22] << "</R22>" << std::endl;
-		stream_rbxmx << "</CoordinateFrame>" << std::endl;
-		stream_rbxmx << "<Vector3 name = \"size\">" << std::endl;
-		stream_rbxmx << "<X>" << i.meshpart->size.x * scale << "</X>" << std::endl;
-		stream_rbxmx << "<Y>" << i.meshpart->size.y * scale << "</Y>" << std::endl;
-		stream_rbxmx << "<Z>" << i.meshpart->size.z * scale << "</Z>" << std::endl;
-		stream_rbxmx << "</Vector3>" << std::endl;
-		stream_rbxmx << "<Vector3 name = \"InitialSize\">" << std::endl;
-		stream_rbxmx << "<X>" << i.meshpart->size.x << "</X>" << std::endl;
-		stream_rbxmx << "<Y>" << i.meshpart->size.y << "</Y>" << std::endl;
-		stream_rbxmx << "<Z>" << i.meshpart->size.z << "</Z>" << std::endl;
-		stream_rbxmx << "</Vector3>" << std::endl;
-		if (!i.meshpart->url.empty())
-			stream_rbxmx << "<Content name=\"MeshID\"><url>" << i.meshpart->url << "</url></Content>" << std::endl;
-		if ((i.meshpart->matflags & NJD_FLAG_USE_TEXTURE) && i.meshpart->texture != nullptr)
-		{
-			stream_rbxmx << "<string name=\"Name\">" << i.meshpart->name_texture << "</string>" << std::endl;
-			stream_rbxmx << "<Content name=\"TextureID\"><url>";
-			stream_rbxmx << i.meshpart->url_texture;
-			stream_rbxmx << "</url></Content>" << std::endl;
-			stream_rbxmx << "<token name=\"Material\">" << i.meshpart->texture->material << "</token>" << std::endl;
-		}
-		else
-		{
-			stream_rbxmx << "<string name=\"Name\">Collision</string>" << std::endl;
-		}
-		stream_rbxmx << "<float name=\"Transparency\">" << ((i.surf_flag & SALVL_SURFFLAG_VISIBLE) ? 0.0f : 1.0f) << "</float>" << std::endl;
-		stream_rbxmx << "<Color3uint8 name = \"Color3uint8\">" << i.meshpart->diffuse << "</Color3uint8>" << std::endl;
-		stream_rbxmx << "</Properties>" << std::endl;
-		if ((i.meshpart->matflags & NJD_FLAG_USE_TEXTURE) && i.meshpart->texture != nullptr && i.meshpart->texture->transparent)
-		{
-			// SurfaceAppearance
-			stream_rbxmx << "<Item class = \"SurfaceAppearance\">" << std::endl;
-				stream_rbxmx << "<Properties>" << std::endl;
-					stream_rbxmx << "<token name=\"AlphaMode\">1</token>" << std::endl;
-					stream_rbxmx << "<Content name=\"ColorMap\"><url>";
-						stream_rbxmx << i.meshpart->url_texture;
-					stream_rbxmx << "</url></Content>" << std::endl;
-				stream_rbxmx << "</Properties>" << std::endl;
-			stream_rbxmx << "</Item>" << std::endl;
-		}
-		stream_rbxmx << "</Item>" << std::endl;
+		collision_csgmesh.push_back(csgmesh);
 	}
-	stream_rbxmx << "</Item>" << std::endl;
-	stream_rbxmx << "</Item>" << std::endl;
-	stream_rbxmx << "</Item>" << std::endl;
-	// Shared Strings (CSGMesh hashes)
-	stream_rbxmx << "<SharedStrings>" << std::endl;
-	std::set<std::string> csgmesh_key;
-	for (auto &i : meshpart_csgmesh)
+
+	// Write model
+	std::cout << "Writing " << path_model << "..." << std::endl;
+
+	if (output_rbxm ? RBXM_Write(path_model, mesh_collision, collision_csgmesh, mesh_visual, scale) : RBXMX_Write(path_model, mesh_collision, collision_csgmesh, mesh_visual, scale))
 	{
-		if (csgmesh_key.find(i.second.enc_hash) == csgmesh_key.end())
-		{
-			stream_rbxmx << "<SharedString md5=\"" << i.second.enc_hash << "\">" << i.second.enc_base64 << "</SharedString>" << std::endl;
-			csgmesh_key.insert(i.second.enc_hash);
-		}
+		std::cout << "Failed to write " << path_model << std::endl;
+		system("pause");
+		return 1;
 	}
-	stream_rbxmx << "</SharedStrings>" << std::endl;
-	stream_rbxmx << "</roblox>" << std::endl;
-	stream_rbxmx.close();
 
 	// Cleanup WSA
 	if (upload)
@@ -1,14 +1,26 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
 #include <vector>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include <functional>
+#include <algorithm>
+#include <memory>
+#include <initializer_list>
 
 #include "ninja.h"
 
+// SIMD support (SSE2 is baseline on x64)
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SALVL_SSE2
+	#include <emmintrin.h>
+#endif
+
 #include <Winsock2.h>
 #include <wininet.h>
 
@@ -19,16 +31,61 @@ typedef Uint32 SALVL_SurfFlag;
 
 #define SALVL_FLAG_REMAP(x, from, to) ((x & from) ? to : 0)
 
+#define SALVL_ALPHA_OPAQUE 0 // Every texel is fully opaque
+#define SALVL_ALPHA_CUTOUT 1 // Every texel is fully opaque or fully clear
+#define SALVL_ALPHA_BLEND  2 // Some texels are partially transparent
+
 // SALVL types
+struct SALVL_StringArena
+{
+	// Append-only string storage, views stay valid for the arena's lifetime
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char *block_next = nullptr;
+	size_t block_left = 0;
+
+	std::string_view Intern(std::initializer_list<std::string_view> parts)
+	{
+		// Concatenate parts into the current block, starting a new one if they don't fit
+		size_t size = 0;
+		for (auto &i : parts)
+			size += i.size();
+		if (size > block_left)
+		{
+			size_t block_size = std::max<size_t>(size, 0x10000);
+			blocks.emplace_back(new char[block_size]);
+			block_next = blocks.back().get();
+			block_left = block_size;
+		}
+
+		char *start = block_next;
+		for (auto &i : parts)
+		{
+			memcpy(block_next, i.data(), i.size());
+			block_next += i.size();
+		}
+		block_left -= size;
+		return std::string_view(start, size);
+	}
+};
+
+struct SALVL_Material
+{
+	std::string_view name;
+	Uint32 value; // Enum.Material value
+	std::string_view token; // Value as written to RBXMX
+};
+extern const SALVL_Material rbxenum_material[]; // Plastic first
+
 struct SALVL_Texture
 {
-	// File information
-	std::string name, name_fu, name_fv, name_fuv;
-	std::string path, path_fu, path_fv, path_fuv;
-	std::string url, url_fu, url_fv, url_fuv;
-	std::string material = "Plastic";
-	int xres = 0, yres = 0;
-	bool transparent = false;
+	// File information, interned in the level's string arena
+	std::string_view name, name_fu, name_fv, name_fuv;
+	std::string_view path, path_fu, path_fv, path_fuv;
+	std::string_view url, url_fu, url_fv, url_fuv;
+	const SALVL_Material *material = &rbxenum_material[0]; // Excluded if null
+	int xres = 0, yres = 0; // Effective resolution after downscaling
+	int xres_variant[4] = {}, yres_variant[4] = {}; // Effective resolution of each variant (base, u, v, uv)
+	Uint8 alpha = SALVL_ALPHA_OPAQUE;
 };
 
 struct SALVL_Vertex
@@ -55,12 +112,14 @@ struct SALVL_Vertex
 	}
 };
 
+typedef Uint32 SALVL_Index;
+
 struct SALVL_MeshFace
 {
-	Sint16 i[3] = {};
+	SALVL_Index i[3] = {};
 
 	SALVL_MeshFace() {}
-	SALVL_MeshFace(Sint16 a, Sint16 b, Sint16 c)
+	SALVL_MeshFace(SALVL_Index a, SALVL_Index b, SALVL_Index c)
 	{
 		i[0] = a;
 		i[1] = b;
@@ -68,33 +127,92 @@ struct SALVL_MeshFace
 	}
 };
 
-struct edge_hash
+struct SALVL_VertexKey
 {
-	template <class T1, class T2>
-	std::size_t operator () (const std::pair<T1, T2> &p) const
+	// Bit pattern of every vertex field
+	Uint32 w[13] = {};
+
+	static Uint32 FloatBits(Float x)
 	{
-		auto h1 = std::hash<T1>{}(p.first);
-		auto h2 = std::hash<T2>{}(p.second);
+		// Fold -0.0 into 0.0 so the key agrees with operator==
+		if (x == 0.0f)
+			return 0;
+		Uint32 bits;
+		memcpy(&bits, &x, sizeof(bits));
+		return bits;
+	}
 
-		return h1 ^ ((int)h2 << 16);
+	SALVL_VertexKey() {}
+	SALVL_VertexKey(const SALVL_Vertex &v)
+	{
+		w[0] = FloatBits(v.pos.x); w[1] = FloatBits(v.pos.y); w[2] = FloatBits(v.pos.z);
+		w[3] = FloatBits(v.tex.x); w[4] = FloatBits(v.tex.y);
+		w[5] = FloatBits(v.nor.x); w[6] = FloatBits(v.nor.y); w[7] = FloatBits(v.nor.z);
+		w[8] = FloatBits(v.tan.x); w[9] = FloatBits(v.tan.y); w[10] = FloatBits(v.tan.z);
+		w[11] = FloatBits(v.ts);
+		w[12] = ((Uint32)v.r) | ((Uint32)v.g << 8) | ((Uint32)v.b << 16) | ((Uint32)v.a << 24);
+	}
+
+	static bool Weldable(const SALVL_Vertex &v)
+	{
+		// NaN never compares equal, so such vertices are never welded
+		return
+			v.pos.x == v.pos.x && v.pos.y == v.pos.y && v.pos.z == v.pos.z &&
+			v.tex.x == v.tex.x && v.tex.y == v.tex.y &&
+			v.nor.x == v.nor.x && v.nor.y == v.nor.y && v.nor.z == v.nor.z &&
+			v.tan.x == v.tan.x && v.tan.y == v.tan.y && v.tan.z == v.tan.z && v.ts == v.ts;
+	}
+
+	inline bool operator==(const SALVL_VertexKey &rhs) const
+	{
+		return memcmp(w, rhs.w, sizeof(w)) == 0;
 	}
 };
 
+struct vertex_hash
+{
+	std::size_t operator () (const SALVL_VertexKey &k) const
+	{
+		// FNV-1a over the key words, with a final avalanche
+		std::uint64_t h = 0xCBF29CE484222325ULL;
+		for (auto &i : k.w)
+		{
+			h ^= i;
+			h *= 0x100000001B3ULL;
+		}
+		h ^= h >> 29;
+		h *= 0xBF58476D1CE4E5B9ULL;
+		h ^= h >> 32;
+		return (std::size_t)h;
+	}
+};
+
+struct SALVL_EdgeRef
+{
+	// Edge bucketed under its lower vertex index
+	SALVL_Index other; // Upper vertex index
+	SALVL_Index face : 31;
+	SALVL_Index forward : 1; // Face walks the edge from lower to upper
+};
+
 struct SALVL_MeshPart
 {
 	// Mesh data
 	std::vector<SALVL_Vertex> vertex;
 	std::vector<SALVL_MeshFace> indices;
 
-	Uint16 AddVertex(SALVL_Vertex &adder)
+	// Welding index, only valid while the part is being built
+	std::unordered_map<SALVL_VertexKey, SALVL_Index, vertex_hash> vertex_index;
+
+	SALVL_Index AddVertex(SALVL_Vertex &adder)
 	{
 		// Check if identical vertex already exists
-		Uint16 j = 0;
-		for (auto &i : vertex)
+		SALVL_Index j = (SALVL_Index)vertex.size();
+		if (SALVL_VertexKey::Weldable(adder))
 		{
-			if (i == adder)
-				return j;
-			j++;
+			auto it = vertex_index.emplace(SALVL_VertexKey(adder), j);
+			if (!it.second)
+				return it.first->second;
 		}
 
 		// Push new vertex
@@ -102,6 +220,12 @@ struct SALVL_MeshPart
 		return j;
 	}
 
+	void ClearVertexIndex()
+	{
+		// Release welding index once the part is complete
+		std::unordered_map<SALVL_VertexKey, SALVL_Index, vertex_hash>().swap(vertex_index);
+	}
+
 	// Material information
 	Uint32 matflags = 0;
 
@@ -115,12 +239,127 @@ struct SALVL_MeshPart
 	std::string url;
 	std::string url_texture;
 
+	std::vector<char> data; // Serialized mesh
+
 	unsigned int ind = 0;
 
 	// AABB
 	NJS_VECTOR aabb_correct = {};
 	NJS_VECTOR size = {};
 
+	std::vector<SALVL_MeshPart> Split(size_t max_vertices) const
+	{
+		// Sort faces into spatially local ranges by recursive median split of their centroids
+		std::vector<NJS_VECTOR> centroid(indices.size());
+		std::vector<size_t> order(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			const auto &va = vertex[indices[i].i[0]].pos;
+			const auto &vb = vertex[indices[i].i[1]].pos;
+			const auto &vc = vertex[indices[i].i[2]].pos;
+			centroid[i] = {(va.x + vb.x + vc.x) / 3.0f, (va.y + vb.y + vc.y) / 3.0f, (va.z + vb.z + vc.z) / 3.0f};
+			order[i] = i;
+		}
+
+		std::vector<SALVL_Index> remap(vertex.size(), (SALVL_Index)-1);
+		auto count_vertices = [&](size_t begin, size_t end) -> size_t
+		{
+			// Count unique vertices referenced by a range of faces
+			size_t count = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				for (auto &k : indices[order[i]].i)
+				{
+					if (remap[k] == (SALVL_Index)-1)
+					{
+						remap[k] = 0;
+						count++;
+					}
+				}
+			}
+			for (size_t i = begin; i < end; i++)
+				for (auto &k : indices[order[i]].i)
+					remap[k] = (SALVL_Index)-1;
+			return count;
+		};
+
+		std::vector<std::pair<size_t, size_t>> ranges;
+		std::vector<std::pair<size_t, size_t>> stack = {{0, indices.size()}};
+		while (!stack.empty())
+		{
+			auto range = stack.back();
+			stack.pop_back();
+
+			if (range.second - range.first <= 1 || count_vertices(range.first, range.second) <= max_vertices)
+			{
+				ranges.push_back(range);
+				continue;
+			}
+
+			// Split along the longest axis of the centroid bounds
+			NJS_VECTOR minv = centroid[order[range.first]], maxv = minv;
+			for (size_t i = range.first; i < range.second; i++)
+			{
+				const auto &c = centroid[order[i]];
+				minv = {std::min(minv.x, c.x), std::min(minv.y, c.y), std::min(minv.z, c.z)};
+				maxv = {std::max(maxv.x, c.x), std::max(maxv.y, c.y), std::max(maxv.z, c.z)};
+			}
+
+			float NJS_VECTOR::*axis = &NJS_VECTOR::x;
+			if (maxv.y - minv.y > maxv.x - minv.x)
+				axis = &NJS_VECTOR::y;
+			if (maxv.z - minv.z > std::max(maxv.x - minv.x, maxv.y - minv.y))
+				axis = &NJS_VECTOR::z;
+
+			size_t mid = range.first + (range.second - range.first) / 2;
+			std::nth_element(order.begin() + range.first, order.begin() + mid, order.begin() + range.second, [&](size_t a, size_t b)
+			{
+				if (centroid[a].*axis != centroid[b].*axis)
+					return centroid[a].*axis < centroid[b].*axis;
+				return a < b;
+			});
+
+			// Push upper half first so ranges come out in order
+			stack.push_back({mid, range.second});
+			stack.push_back({range.first, mid});
+		}
+
+		// Build a part for each range
+		std::vector<SALVL_MeshPart> pieces;
+		for (auto &range : ranges)
+		{
+			SALVL_MeshPart piece;
+			piece.matflags = matflags;
+			piece.texture = texture;
+			piece.diffuse = diffuse;
+
+			std::sort(order.begin() + range.first, order.begin() + range.second);
+			for (size_t i = range.first; i < range.second; i++)
+			{
+				SALVL_MeshFace face;
+				for (int k = 0; k < 3; k++)
+				{
+					SALVL_Index &r = remap[indices[order[i]].i[k]];
+					if (r == (SALVL_Index)-1)
+					{
+						r = (SALVL_Index)piece.vertex.size();
+						piece.vertex.push_back(vertex[indices[order[i]].i[k]]);
+					}
+					face.i[k] = r;
+				}
+				piece.indices.push_back(face);
+			}
+
+			for (size_t i = range.first; i < range.second; i++)
+				for (auto &k : indices[order[i]].i)
+					remap[k] = (SALVL_Index)-1;
+
+			pieces.push_back(std::move(piece));
+		}
+
+		return pieces;
+	}
+
 	void AABBCorrect()
 	{
 		// Get current bounding box
@@ -171,108 +410,101 @@ struct SALVL_MeshPart
 		}
 	}
 
-	void AutoNormals()
+	void BuildEdges(std::vector<SALVL_Index> &edge_start, std::vector<SALVL_EdgeRef> &edges) const
 	{
-		// Make sure faces connect with the same winding order by their edges, and flip if necessary
-		std::unordered_map<std::pair<Sint16, Sint16>, std::vector<int>, edge_hash> edges;
-		std::unordered_set<int> fixed;
-
+		// Bucket face edges by their lower vertex index (CSR)
+		edge_start.assign(vertex.size() + 1, 0);
 		for (auto &i : indices)
+			for (int k = 0; k < 3; k++)
+				edge_start[std::min(i.i[k], i.i[(k + 1) % 3]) + 1]++;
+		for (size_t i = 0; i < vertex.size(); i++)
+			edge_start[i + 1] += edge_start[i];
+
+		edges.resize(indices.size() * 3);
+		std::vector<SALVL_Index> edge_fill(edge_start.begin(), edge_start.end() - 1);
+		for (size_t f = 0; f < indices.size(); f++)
 		{
-			const auto e0 = std::pair<Sint16, Sint16>{ i.i[0], i.i[1] };
-			const auto e1 = std::pair<Sint16, Sint16>{ i.i[1], i.i[2] };
-			const auto e2 = std::pair<Sint16, Sint16>{ i.i[2], i.i[0] };
-			edges[e0].push_back(&i - indices.data());
-			edges[e1].push_back(&i - indices.data());
-			edges[e2].push_back(&i - indices.data());
-		}
-
-		std::function<void(SALVL_MeshFace&)> fix;
-		fix = [&fix, &fixed, this, &edges](SALVL_MeshFace& i) -> void
-		{
-			const auto e0 = std::pair<Sint16, Sint16>{ i.i[0], i.i[1] };
-			const auto e1 = std::pair<Sint16, Sint16>{ i.i[1], i.i[2] };
-			const auto e2 = std::pair<Sint16, Sint16>{ i.i[2], i.i[0] };
-
-			const auto oe0 = std::pair<Sint16, Sint16>{ i.i[0], i.i[1] };
-			const auto oe1 = std::pair<Sint16, Sint16>{ i.i[1], i.i[2] };
-			const auto oe2 = std::pair<Sint16, Sint16>{ i.i[2], i.i[0] };
-
-			fixed.insert(&i - indices.data());
-
-			for (auto& o : edges[oe0])
+			for (int k = 0; k < 3; k++)
 			{
-				auto it = fixed.find(o);
-				if (it != fixed.end())
-					continue;
-
-				auto& oi = indices[o];
-				std::swap(oi.i[0], oi.i[1]);
-				fix(oi);
-			}
-
-			for (auto& o : edges[oe1])
-			{
-				auto it = fixed.find(o);
-				if (it != fixed.end())
-					continue;
-
-				auto& oi = indices[o];
-				std::swap(oi.i[1], oi.i[2]);
-				fix(oi);
-			}
-
-			for (auto& o : edges[oe2])
-			{
-				auto it = fixed.find(o);
-				if (it != fixed.end())
-					continue;
-
-				auto& oi = indices[o];
-				std::swap(oi.i[2], oi.i[0]);
-				fix(oi);
-			}
-
-			for (auto &o : edges[e0])
-			{
-				auto it = fixed.find(o);
-				if (it != fixed.end())
-					continue;
-
-				auto &oi = indices[o];
-				fix(oi);
+				SALVL_Index a = indices[f].i[k];
+				SALVL_Index b = indices[f].i[(k + 1) % 3];
+				SALVL_EdgeRef &ref = edges[edge_fill[std::min(a, b)]++];
+				ref.other = std::max(a, b);
+				ref.face = (SALVL_Index)f;
+				ref.forward = (a < b) ? 1 : 0;
 			}
+		}
 
-			for (auto &o : edges[e1])
+		// Sort each bucket by upper vertex, so shared edges can be found by binary search
+		for (size_t i = 0; i < vertex.size(); i++)
+		{
+			std::sort(edges.begin() + edge_start[i], edges.begin() + edge_start[i + 1], [](const SALVL_EdgeRef &a, const SALVL_EdgeRef &b)
 			{
-				auto it = fixed.find(o);
-				if (it != fixed.end())
-					continue;
+				return (a.other != b.other) ? (a.other < b.other) : (a.face < b.face);
+			});
+		}
+	}
 
-				auto &oi = indices[o];
-				fix(oi);
-			}
+	static std::pair<const SALVL_EdgeRef*, const SALVL_EdgeRef*> FindEdge(const std::vector<SALVL_Index> &edge_start, const std::vector<SALVL_EdgeRef> &edges, SALVL_Index lo, SALVL_Index hi)
+	{
+		// Get the faces sharing edge lo-hi from the buckets made by BuildEdges
+		const SALVL_EdgeRef *begin = edges.data() + edge_start[lo], *end = edges.data() + edge_start[lo + 1];
+		begin = std::lower_bound(begin, end, hi, [](const SALVL_EdgeRef &ref, SALVL_Index i) { return ref.other < i; });
+		end = std::upper_bound(begin, end, hi, [](SALVL_Index i, const SALVL_EdgeRef &ref) { return i < ref.other; });
+		return { begin, end };
+	}
 
-			for (auto &o : edges[e2])
-			{
-				auto it = fixed.find(o);
-				if (it != fixed.end())
-					continue;
+	void AutoNormals()
+	{
+		// Make sure faces connect with the same winding order by their edges, and flip if necessary
+		std::vector<SALVL_Index> edge_start;
+		std::vector<SALVL_EdgeRef> edges;
+		BuildEdges(edge_start, edges);
 
-				auto &oi = indices[o];
-				fix(oi);
-			}
-		};
+		// Breadth-first flood fill from each unvisited face, deciding which faces to flip
+		std::vector<bool> visited(indices.size(), false);
+		std::vector<bool> flip(indices.size(), false);
+		std::vector<SALVL_Index> worklist;
+		worklist.reserve(indices.size());
 
-		for (auto& i : indices)
+		for (size_t seed = 0; seed < indices.size(); seed++)
 		{
-			auto it = fixed.find(&i - indices.data());
-			if (it != fixed.end())
+			if (visited[seed])
 				continue;
+			visited[seed] = true;
 
-			fix(i);
+			worklist.clear();
+			worklist.push_back((SALVL_Index)seed);
+			for (size_t head = 0; head < worklist.size(); head++)
+			{
+				SALVL_Index f = worklist[head];
+				for (int k = 0; k < 3; k++)
+				{
+					SALVL_Index a = indices[f].i[k];
+					SALVL_Index b = indices[f].i[(k + 1) % 3];
+					SALVL_Index lo = std::min(a, b), hi = std::max(a, b);
+					bool forward = a < b;
+
+					auto range = FindEdge(edge_start, edges, lo, hi);
+					for (const SALVL_EdgeRef *e = range.first; e != range.second; e++)
+					{
+						const SALVL_EdgeRef &ref = *e;
+						if (visited[ref.face])
+							continue;
+
+						// A neighbour walking the shared edge the same way is wound opposite to us
+						visited[ref.face] = true;
+						flip[ref.face] = flip[f] != (((bool)ref.forward) == forward);
+						worklist.push_back(ref.face);
+					}
+				}
+			}
 		}
 
+		for (size_t f = 0; f < indices.size(); f++)
+			if (flip[f])
+				std::swap(indices[f].i[0], indices[f].i[1]);
+
 		// Clear normals
 		for (auto &i : vertex)
 		{
@@ -281,25 +513,20 @@ struct SALVL_MeshPart
 			i.nor.z = 0.0f;
 		}
 
-		// Calculate normals
-		std::vector<int> sums(vertex.size());
-
+		// Accumulate face normals
 		for (auto &i : indices)
 		{
-			int i0 = i.i[0];
-			int i1 = i.i[1];
-			int i2 = i.i[2];
-			auto &va = vertex[i0];
-			auto &vb = vertex[i1];
-			auto &vc = vertex[i2];
+			auto &va = vertex[i.i[0]];
+			auto &vb = vertex[i.i[1]];
+			auto &vc = vertex[i.i[2]];
 
 			NJS_VECTOR ab = {vb.pos.x - va.pos.x, vb.pos.y - va.pos.y, vb.pos.z - va.pos.z};
 			NJS_VECTOR ac = {vc.pos.x - va.pos.x, vc.pos.y - va.pos.y, vc.pos.z - va.pos.z};
 			NJS_VECTOR normal = {ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x};
 
-			float dot = normal.x * va.nor.x + normal.y * va.nor.y + normal.z * va.nor.z;
-
 			float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+			if (!(length > 0.0f))
+				continue; // Degenerate face
 			normal.x /= length;
 			normal.y /= length;
 			normal.z /= length;
@@ -315,24 +542,22 @@ struct SALVL_MeshPart
 			vc.nor.x += normal.x;
 			vc.nor.y += normal.y;
 			vc.nor.z += normal.z;
-
-			sums[i0]++;
-			sums[i1]++;
-			sums[i2]++;
 		}
 
-		for (unsigned int i = 0; i < vertex.size(); i++)
+		// Normalize
+		for (auto &v : vertex)
 		{
-			auto &v = vertex[i];
-			int length = sums[i];
-			v.nor.x /= length;
-			v.nor.y /= length;
-			v.nor.z /= length;
-
-			float length2 = sqrtf(v.nor.x * v.nor.x + v.nor.y * v.nor.y + v.nor.z * v.nor.z);
-			v.nor.x /= length2;
-			v.nor.y /= length2;
-			v.nor.z /= length2;
+			float length = sqrtf(v.nor.x * v.nor.x + v.nor.y * v.nor.y + v.nor.z * v.nor.z);
+			if (length > 0.0f)
+			{
+				v.nor.x /= length;
+				v.nor.y /= length;
+				v.nor.z /= length;
+			}
+			else
+			{
+				v.nor = {0.0f, 1.0f, 0.0f};
+			}
 		}
 	}
 };
@@ -342,6 +567,34 @@ struct SALVL_Mesh
 	// Contained mesh parts
 	std::unordered_map<int, SALVL_MeshPart> parts;
 	bool do_upload = false; // Only upload parts if visible
+
+	void Split(size_t max_vertices)
+	{
+		// Split parts with too many vertices in key order, appending pieces under new keys
+		if (max_vertices < 3)
+			max_vertices = 3;
+
+		std::vector<int> keys;
+		int next_key = 0;
+		for (auto &i : parts)
+		{
+			keys.push_back(i.first);
+			if (i.first >= next_key)
+				next_key = i.first + 1;
+		}
+		std::sort(keys.begin(), keys.end());
+
+		for (auto &i : keys)
+		{
+			if (parts[i].vertex.size() <= max_vertices)
+				continue;
+
+			std::vector<SALVL_MeshPart> pieces = parts[i].Split(max_vertices);
+			parts[i] = std::move(pieces[0]);
+			for (size_t j = 1; j < pieces.size(); j++)
+				parts[next_key++] = std::move(pieces[j]);
+		}
+	}
 };
 
 struct SALVL_MeshInstance
@@ -375,8 +628,10 @@ struct SALVL
 {
 	// Level assets
 	std::vector<SALVL_Texture> textures;
+	std::vector<SALVL_Texture> atlases; // Kept apart so pointers into textures stay valid
 	std::unordered_map<void*, SALVL_Mesh> meshes;
 	std::vector<SALVL_MeshInstance> meshinstances;
+	SALVL_StringArena strings;
 };
 
 // Ninja reimplementation
@@ -384,5 +639,12 @@ void Reimp_njRotateX(NJS_MATRIX cframe, Angle x);
 void Reimp_njRotateY(NJS_MATRIX cframe, Angle x);
 void Reimp_njRotateZ(NJS_MATRIX cframe, Angle x);
 
+// Texture mirroring
+void MirrorRGBA8(const Uint8 *src, int w, int h, Uint8 *fu, Uint8 *fv, Uint8 *fuv); // Any output may be null
+
+// Parallel jobs
+void SALVL_ParallelFor(unsigned int jobs, size_t count, const std::function<void(size_t, unsigned int)> &func); // Also passes the worker index
+void SALVL_ParallelFor(unsigned int jobs, size_t count, const std::function<void(size_t)> &func);
+
 // Entry point
 int SALVL2RBX(int argc, char *argv[], int (loader)(SALVL&, std::string));
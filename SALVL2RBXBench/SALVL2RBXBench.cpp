@@ -0,0 +1,207 @@
+#include "SALVL2RBX.h"
+
+#include <iostream>
+#include <chrono>
+
+// Timing
+template <typename T> static double Bench_Time(T func)
+{
+	// Run once and return milliseconds taken
+	auto start = std::chrono::steady_clock::now();
+	func();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Vertex welding
+static SALVL_Index Bench_AddVertexScan(SALVL_MeshPart &meshpart, SALVL_Vertex &adder)
+{
+	// Linear scan AddVertex used before the welding index
+	SALVL_Index j = 0;
+	for (auto &i : meshpart.vertex)
+	{
+		if (i == adder)
+			return j;
+		j++;
+	}
+	meshpart.vertex.push_back(adder);
+	return j;
+}
+
+static bool Bench_Weld(int grid)
+{
+	// Dense grid where every interior vertex is shared by six corners
+	std::vector<SALVL_Vertex> corners;
+	for (int y = 0; y + 1 < grid; y++)
+	{
+		for (int x = 0; x + 1 < grid; x++)
+		{
+			static const int quad[6][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+			for (auto &q : quad)
+			{
+				SALVL_Vertex v;
+				v.pos = { (float)(x + q[0]), 0.0f, (float)(y + q[1]) };
+				v.tex = { (x + q[0]) / (float)grid, (y + q[1]) / (float)grid };
+				corners.push_back(v);
+			}
+		}
+	}
+
+	SALVL_MeshPart scan, hashed;
+	std::vector<SALVL_Index> scan_indices, hashed_indices;
+	double scan_ms = Bench_Time([&]()
+	{
+		for (auto &i : corners)
+			scan_indices.push_back(Bench_AddVertexScan(scan, i));
+	});
+	double hashed_ms = Bench_Time([&]()
+	{
+		for (auto &i : corners)
+			hashed_indices.push_back(hashed.AddVertex(i));
+	});
+
+	bool match = scan_indices == hashed_indices && scan.vertex.size() == hashed.vertex.size();
+	std::cout << "weld: " << grid << "x" << grid << " grid, " << corners.size() << " corners, " << hashed.vertex.size() << " unique" << std::endl;
+	std::cout << "  linear scan " << scan_ms << " ms, hashed " << hashed_ms << " ms, indices " << (match ? "identical" : "DIFFER") << std::endl;
+	return !match;
+}
+
+// AutoNormals
+static bool Bench_Normals(int faces)
+{
+	// Triangle fan with random winding, so every face shares the hub vertex
+	SALVL_MeshPart meshpart;
+	meshpart.vertex.resize((size_t)faces + 2);
+	for (int i = 1; i < faces + 2; i++)
+		meshpart.vertex[i].pos = { cosf(i * 0.0001f), 0.0f, sinf(i * 0.0001f) };
+
+	Uint32 random = 1;
+	for (int i = 1; i <= faces; i++)
+	{
+		random = random * 1103515245 + 12345;
+		if ((random >> 16) & 1)
+			meshpart.indices.push_back(SALVL_MeshFace(0, i, i + 1));
+		else
+			meshpart.indices.push_back(SALVL_MeshFace(i, 0, i + 1));
+	}
+
+	double ms = Bench_Time([&]() { meshpart.AutoNormals(); });
+
+	// Every face should end up wound the same way around the hub
+	size_t forward = 0;
+	for (auto &f : meshpart.indices)
+	{
+		int hub = (f.i[0] == 0) ? 0 : (f.i[1] == 0) ? 1 : 2;
+		if (f.i[(hub + 1) % 3] < f.i[(hub + 2) % 3])
+			forward++;
+	}
+	bool consistent = forward == 0 || forward == meshpart.indices.size();
+	std::cout << "normals: " << faces << " face fan" << std::endl;
+	std::cout << "  AutoNormals " << ms << " ms, winding " << (consistent ? "consistent" : "INCONSISTENT") << std::endl;
+	return !consistent;
+}
+
+// Texture mirroring
+static void Bench_MirrorScalar(const Uint8 *src, int w, int h, Uint8 *fu, Uint8 *fv, Uint8 *fuv)
+{
+	// Column-major mirror loops used before the row kernel
+	size_t p = (size_t)w * 4;
+	for (int x = 0; x < w * 2; x++)
+	{
+		int src_x = x;
+		if (src_x >= w)
+			src_x = w * 2 - src_x - 1;
+		for (int y = 0; y < h; y++)
+			memcpy(fu + (y * p * 2) + (x * 4), src + (y * p) + (src_x * 4), 4);
+	}
+
+	memcpy(fv, src, p * h);
+	for (int y = 0; y < h; y++)
+		memcpy(fv + p * (h + y), src + p * (h - y - 1), p);
+
+	memcpy(fuv, fu, p * 2 * h);
+	for (int y = 0; y < h; y++)
+		memcpy(fuv + p * 2 * (h + y), fu + p * 2 * (h - y - 1), p * 2);
+}
+
+static bool Bench_Mirror(int size, int repeats)
+{
+	// Check against the scalar loops on awkward sizes first
+	static const int widths[] = { 1, 2, 3, 5, 7, 13, 31, 33, 255, 257 };
+	bool match = true;
+	for (int w : widths)
+	{
+		for (int h : { 1, 3, 8 })
+		{
+			std::vector<Uint8> src((size_t)w * h * 4);
+			for (size_t i = 0; i < src.size(); i++)
+				src[i] = (Uint8)(i * 131 + i / 7);
+
+			size_t out = src.size() * 2;
+			std::vector<Uint8> fu(out), fv(out), fuv(out * 2), ref_fu(out), ref_fv(out), ref_fuv(out * 2);
+			MirrorRGBA8(src.data(), w, h, fu.data(), fv.data(), fuv.data());
+			Bench_MirrorScalar(src.data(), w, h, ref_fu.data(), ref_fv.data(), ref_fuv.data());
+
+			// UV alone builds its own horizontal flip
+			std::vector<Uint8> fuv_only(out * 2);
+			MirrorRGBA8(src.data(), w, h, nullptr, nullptr, fuv_only.data());
+
+			if (fu != ref_fu || fv != ref_fv || fuv != ref_fuv || fuv_only != ref_fuv)
+			{
+				std::cout << "  mismatch at " << w << "x" << h << std::endl;
+				match = false;
+			}
+		}
+	}
+
+	// Time all three variants of a square texture
+	std::vector<Uint8> src((size_t)size * size * 4);
+	for (size_t i = 0; i < src.size(); i++)
+		src[i] = (Uint8)i;
+	std::vector<Uint8> fu(src.size() * 2), fv(src.size() * 2), fuv(src.size() * 4);
+
+	double scalar_ms = Bench_Time([&]()
+	{
+		for (int i = 0; i < repeats; i++)
+			Bench_MirrorScalar(src.data(), size, size, fu.data(), fv.data(), fuv.data());
+	}) / repeats;
+	double kernel_ms = Bench_Time([&]()
+	{
+		for (int i = 0; i < repeats; i++)
+			MirrorRGBA8(src.data(), size, size, fu.data(), fv.data(), fuv.data());
+	}) / repeats;
+
+	std::cout << "mirror: " << size << "x" << size << " texture, U, V and UV variants" << std::endl;
+	std::cout << "  scalar " << scalar_ms << " ms, row kernel " << kernel_ms << " ms, odd sizes " << (match ? "identical" : "DIFFER") << std::endl;
+	return !match;
+}
+
+int main(int argc, char *argv[])
+{
+	// SALVL2RBXBench [case], cases are weld, normals and mirror, all by default
+	std::string which = (argc > 1) ? argv[1] : "all";
+	bool failed = false;
+	bool ran = false;
+
+	if (which == "all" || which == "weld")
+	{
+		failed |= Bench_Weld(180);
+		ran = true;
+	}
+	if (which == "all" || which == "normals")
+	{
+		failed |= Bench_Normals(100000);
+		ran = true;
+	}
+	if (which == "all" || which == "mirror")
+	{
+		failed |= Bench_Mirror(1024, 20);
+		ran = true;
+	}
+
+	if (!ran)
+	{
+		std::cout << "Unknown bench " << which << std::endl;
+		return 1;
+	}
+	return failed ? 1 : 0;
+}